@@ -0,0 +1,308 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "movegen.h"
+
+namespace {
+
+const char ARCHIVE_MAGIC[8] = {'E', 'C', 'G', 'A', 'M', 'E', 'S', '1'};
+const char INDEX_MAGIC[8] = {'E', 'C', 'G', 'I', 'D', 'X', '0', '1'};
+const size_t RECORD_HEADER = 16;
+const size_t INDEX_HEADER = 32;
+const int CUSTOM_START = 1;
+
+uint64_t readLittleEndian(const unsigned char* bytes, int count) {
+    uint64_t value = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+void appendLittleEndian(std::vector<unsigned char>& bytes, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        bytes.push_back((unsigned char)(value >> (8 * i)));
+    }
+}
+
+#ifdef _WIN32
+
+// No mmap here; files are read into memory instead.
+bool mapFile(const std::string& path, const unsigned char*& data, size_t& length) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.empty()) return false;
+    
+    unsigned char* copy = new unsigned char[bytes.size()];
+    std::copy(bytes.begin(), bytes.end(), copy);
+    data = copy;
+    length = bytes.size();
+    return true;
+}
+
+void unmapFile(const unsigned char* data, size_t) {
+    delete[] data;
+}
+
+#else
+
+bool mapFile(const std::string& path, const unsigned char*& data, size_t& length) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    
+    data = static_cast<const unsigned char*>(mapping);
+    length = size_t(info.st_size);
+    return true;
+}
+
+void unmapFile(const unsigned char* data, size_t length) {
+    munmap(const_cast<unsigned char*>(data), length);
+}
+
+#endif
+
+}
+
+GameArchive::GameArchive() : data(nullptr), length(0) {}
+
+GameArchive::~GameArchive() {
+    close();
+}
+
+bool GameArchive::append(const std::string& path, const Board& board, GameOutcome outcome) {
+    Board start = board;
+    while (!start.getMoveHistory().empty()) {
+        start.undoLastMove();
+    }
+    const std::vector<MoveRecord>& history = board.getMoveHistory();
+    if (history.size() > 0xFFFF) return false;
+    
+    std::string fen = start.toFEN();
+    bool custom = fen != Board().toFEN();
+    std::vector<unsigned char> record;
+    appendLittleEndian(record, 0, 4);  // size, filled in below
+    appendLittleEndian(record, history.size(), 2);
+    record.push_back((unsigned char)outcome);
+    record.push_back(custom ? CUSTOM_START : 0);
+    appendLittleEndian(record, uint64_t(std::time(nullptr)), 8);
+    if (custom) {
+        appendLittleEndian(record, fen.size(), 2);
+        record.insert(record.end(), fen.begin(), fen.end());
+        if (fen.size() % 2 != 0) record.push_back(0);
+    }
+    for (const MoveRecord& move : history) {
+        appendLittleEndian(record, move.move.raw(), 2);
+    }
+    uint32_t size = uint32_t(record.size());
+    for (int i = 0; i < 4; i++) {
+        record[i] = (unsigned char)(size >> (8 * i));
+    }
+    
+    // One write per record, so a crash can only cut off the last one.
+    std::FILE* out = std::fopen(path.c_str(), "ab");
+    if (!out) return false;
+    bool written = true;
+    if (std::fseek(out, 0, SEEK_END) == 0 && std::ftell(out) == 0) {
+        unsigned char header[FIRST_GAME] = {};
+        std::memcpy(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        written = std::fwrite(header, 1, sizeof(header), out) == sizeof(header);
+    }
+    written = written && std::fwrite(record.data(), 1, record.size(), out) == record.size();
+    return std::fclose(out) == 0 && written;
+}
+
+bool GameArchive::open(const std::string& path) {
+    close();
+    if (!mapFile(path, data, length)) return false;
+    if (length < FIRST_GAME || std::memcmp(data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void GameArchive::close() {
+    if (data) unmapFile(data, length);
+    data = nullptr;
+    length = 0;
+}
+
+bool GameArchive::gameAt(uint64_t offset, Game& game, uint64_t& next) const {
+    if (!data || offset < FIRST_GAME || offset + RECORD_HEADER > length) return false;
+    const unsigned char* record = data + offset;
+    uint64_t size = readLittleEndian(record, 4);
+    if (size < RECORD_HEADER || offset + size > length || record[6] > DRAWN) return false;
+    
+    game.offset = offset;
+    game.moveCount = int(readLittleEndian(record + 4, 2));
+    game.outcome = GameOutcome(record[6]);
+    game.timestamp = readLittleEndian(record + 8, 8);
+    game.fen = nullptr;
+    game.fenLength = 0;
+    size_t position = RECORD_HEADER;
+    if (record[7] & CUSTOM_START) {
+        if (position + 2 > size) return false;
+        game.fenLength = size_t(readLittleEndian(record + position, 2));
+        game.fen = reinterpret_cast<const char*>(record + position + 2);
+        position += 2 + game.fenLength + game.fenLength % 2;
+    }
+    if (position + 2 * size_t(game.moveCount) > size) return false;
+    game.moves = record + position;
+    next = offset + size;
+    return true;
+}
+
+bool GameArchive::replay(const Game& game, Board& board, const std::function<bool(const Board&, int ply)>& visit) {
+    if (game.fen) {
+        if (!board.loadFEN(std::string(game.fen, game.fenLength))) return false;
+    } else {
+        board.initializeBoard();
+    }
+    
+    MoveRecord record;
+    for (int ply = 0; ply < game.moveCount; ply++) {
+        if (!visit(board, ply)) return true;
+        // A move from a damaged record must not leave the board in a state
+        // no game can reach.
+        Move move = game.move(ply);
+        if (!isLegalMove(board, move)) return false;
+        board.makeTemporaryMove(move, record);
+    }
+    visit(board, game.moveCount);
+    return true;
+}
+
+PositionIndex::PositionIndex() : data(nullptr), length(0) {}
+
+PositionIndex::~PositionIndex() {
+    close();
+}
+
+bool PositionIndex::build(const GameArchive& archive, const std::string& path) {
+    std::vector<Entry> entries;
+    uint64_t offset = GameArchive::FIRST_GAME, next = 0;
+    GameArchive::Game game;
+    Board board;
+    while (archive.gameAt(offset, game, next)) {
+        GameArchive::replay(game, board, [&](const Board& position, int ply) {
+            entries.push_back(Entry{position.getKey(), offset << 16 | uint64_t(ply)});
+            return true;
+        });
+        offset = next;
+    }
+    
+    // A game that comes back to a position is listed there once, at the
+    // first time: with the same key and game that entry sorts first.
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.key != b.key ? a.key < b.key : a.location < b.location;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const Entry& a, const Entry& b) {
+                                  return a.key == b.key && a.gameOffset() == b.gameOffset();
+                              }),
+                  entries.end());
+    
+    std::vector<unsigned char> header;
+    header.insert(header.end(), INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+    appendLittleEndian(header, offset, 8);
+    appendLittleEndian(header, entries.size(), 8);
+    header.resize(INDEX_HEADER, 0);
+    
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) return false;
+    bool written = std::fwrite(header.data(), 1, header.size(), out) == header.size() &&
+                   std::fwrite(entries.data(), sizeof(Entry), entries.size(), out) == entries.size();
+    return std::fclose(out) == 0 && written;
+}
+
+bool PositionIndex::open(const std::string& path) {
+    close();
+    if (!mapFile(path, data, length)) return false;
+    if (length < INDEX_HEADER || std::memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        length != INDEX_HEADER + getEntryCount() * sizeof(Entry)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PositionIndex::close() {
+    if (data) unmapFile(data, length);
+    data = nullptr;
+    length = 0;
+}
+
+uint64_t PositionIndex::getCoveredBytes() const {
+    return data ? readLittleEndian(data + 8, 8) : 0;
+}
+
+uint64_t PositionIndex::getEntryCount() const {
+    return data ? readLittleEndian(data + 16, 8) : 0;
+}
+
+const PositionIndex::Entry* PositionIndex::find(uint64_t key, size_t& count) const {
+    count = 0;
+    if (!data) return nullptr;
+    const Entry* entries = reinterpret_cast<const Entry*>(data + INDEX_HEADER);
+    const Entry* end = entries + getEntryCount();
+    const Entry* first = std::lower_bound(entries, end, key, [](const Entry& entry, uint64_t k) { return entry.key < k; });
+    const Entry* last = first;
+    while (last != end && last->key == key) {
+        last++;
+    }
+    count = size_t(last - first);
+    return first;
+}
+
+std::vector<PositionHit> findPosition(const GameArchive& archive, const PositionIndex& index, uint64_t key) {
+    std::vector<PositionHit> hits;
+    GameArchive::Game game;
+    uint64_t next = 0;
+    
+    // An index longer than the archive belongs to some other file.
+    uint64_t covered = GameArchive::FIRST_GAME;
+    if (index.isOpen() && index.getCoveredBytes() <= archive.getSize()) {
+        size_t count = 0;
+        const PositionIndex::Entry* entries = index.find(key, count);
+        for (size_t i = 0; i < count; i++) {
+            if (archive.gameAt(entries[i].gameOffset(), game, next)) {
+                hits.push_back(PositionHit{entries[i].gameOffset(), entries[i].ply(), game.outcome});
+            }
+        }
+        covered = index.getCoveredBytes();
+    }
+    
+    Board board;
+    for (uint64_t offset = covered; archive.gameAt(offset, game, next); offset = next) {
+        GameArchive::replay(game, board, [&](const Board& position, int ply) {
+            if (position.getKey() != key) return true;
+            hits.push_back(PositionHit{offset, ply, game.outcome});
+            return false;
+        });
+    }
+    return hits;
+}
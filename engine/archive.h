@@ -0,0 +1,134 @@
+#ifndef CHESS_ENGINE_ARCHIVE_H
+#define CHESS_ENGINE_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+enum GameOutcome {
+    UNFINISHED = 0,  // abandoned, or stopped without a result
+    WHITE_WINS = 1,
+    BLACK_WINS = 2,
+    DRAWN = 3
+};
+
+// Finished games, appended one record at a time to a single file and never
+// rewritten. The file is a 16-byte header (the magic, then zeros) followed
+// by one record per game, all little-endian:
+//
+//   uint32 record size in bytes, this header included
+//   uint16 number of moves
+//   uint8  GameOutcome
+//   uint8  flags: 1 if the game did not start from the initial position
+//   uint64 time the game was stored, in seconds since 1970
+//   uint16 FEN length, then the FEN, padded to an even length  (flag 1 only)
+//   uint16 per move: Move::raw()
+//
+// The file is mapped read-only like the opening book, and games are read in
+// place. A record cut short by a crash while it was written ends the
+// archive there.
+class GameArchive {
+public:
+    // One record, pointing into the mapping.
+    struct Game {
+        uint64_t offset;
+        GameOutcome outcome;
+        uint64_t timestamp;
+        int moveCount;
+        const char* fen;  // null for the initial position
+        size_t fenLength;
+        const unsigned char* moves;
+        
+        Move move(int ply) const { return Move::fromRaw(uint16_t(moves[2 * ply] | moves[2 * ply + 1] << 8)); }
+    };
+    
+    GameArchive();
+    ~GameArchive();
+    
+    GameArchive(const GameArchive&) = delete;
+    GameArchive& operator=(const GameArchive&) = delete;
+    
+    // Appends the game played on `board`, its move history from the
+    // position the board started at, to the archive at `path`, creating
+    // the file if needed.
+    static bool append(const std::string& path, const Board& board, GameOutcome outcome);
+    
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    uint64_t getSize() const { return length; }
+    
+    // Offset of the first record; the next one is at offset + size.
+    static const uint64_t FIRST_GAME = 16;
+    // Reads the record at `offset`, and where the one after it starts;
+    // false at the end of the archive.
+    bool gameAt(uint64_t offset, Game& game, uint64_t& next) const;
+    
+    // Plays the game through on `board` from its start, calling `visit`
+    // with the position before each move and after the last; `visit`
+    // returns false to stop. Returns false if a move is impossible, which
+    // only a damaged file produces.
+    static bool replay(const Game& game, Board& board, const std::function<bool(const Board&, int ply)>& visit);
+
+private:
+    const unsigned char* data;
+    size_t length;
+};
+
+// Sidecar index of an archive from position (Board::getKey()) to the games
+// that reached it: 16-byte entries sorted by key, each the key and the
+// record's offset shifted left 16 bits with the ply it was first reached
+// at in the low bits. A 32-byte header holds the magic, how many bytes of
+// the archive the index covers and the number of entries. It is mapped
+// like the archive and its entries are read in place, so it is only valid
+// on little-endian machines like the one that built it. A lookup is a
+// binary search.
+class PositionIndex {
+public:
+    struct Entry {
+        uint64_t key;
+        uint64_t location;
+        
+        uint64_t gameOffset() const { return location >> 16; }
+        int ply() const { return int(location & 0xFFFF); }
+    };
+    
+    PositionIndex();
+    ~PositionIndex();
+    
+    PositionIndex(const PositionIndex&) = delete;
+    PositionIndex& operator=(const PositionIndex&) = delete;
+    
+    // Indexes every game of `archive` and writes the index to `path`.
+    static bool build(const GameArchive& archive, const std::string& path);
+    
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    uint64_t getCoveredBytes() const;
+    uint64_t getEntryCount() const;
+    
+    // The entries for `key`, in archive order, as a range of the mapping.
+    const Entry* find(uint64_t key, size_t& count) const;
+
+private:
+    const unsigned char* data;
+    size_t length;
+};
+
+struct PositionHit {
+    uint64_t gameOffset;
+    int ply;
+    GameOutcome outcome;
+};
+
+// Every game of the archive that reached the position with `key`. Games
+// the index covers are looked up; games appended after it was built are
+// replayed. The index may be closed, in which case all games are replayed.
+std::vector<PositionHit> findPosition(const GameArchive& archive, const PositionIndex& index, uint64_t key);
+
+#endif
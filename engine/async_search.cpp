@@ -0,0 +1,112 @@
+#include "async_search.h"
+
+AsyncSearch::AsyncSearch(size_t hashMegabytes)
+    : search(hashMegabytes), stopFlag(false), thinking(false), pondering(false), hasResult(false), hasInfo(false) {
+    search.setStopFlag(&stopFlag);
+    search.setPonderFlag(&pondering);
+    search.setInfoCallback([this](const SearchInfo& info) {
+        std::lock_guard<std::mutex> lock(infoMutex);
+        latestInfo = info;
+        hasInfo = true;
+    });
+}
+
+AsyncSearch::~AsyncSearch() {
+    cancel();
+}
+
+void AsyncSearch::start(const Board& position, const SearchLimits& limits) {
+    launch(position, limits, false);
+}
+
+void AsyncSearch::ponder(const Board& position, const SearchLimits& limits) {
+    launch(position, limits, true);
+}
+
+void AsyncSearch::launch(const Board& position, const SearchLimits& limits, bool ponderFirst) {
+    cancel();
+    
+    search.setPosition(position);
+    {
+        std::lock_guard<std::mutex> lock(infoMutex);
+        latestInfo.pvLength = 0;
+        hasInfo = false;
+    }
+    stopFlag.store(false);
+    pondering.store(ponderFirst);
+    thinking.store(true, std::memory_order_release);
+    worker = std::thread([this, limits]() {
+        result = search.getBestMove(limits);
+        hasResult = true;
+        thinking.store(false, std::memory_order_release);
+    });
+}
+
+void AsyncSearch::cancel() {
+    if (worker.joinable()) {
+        stopFlag.store(true);
+        worker.join();
+    }
+    thinking.store(false);
+    pondering.store(false);
+    hasResult = false;
+}
+
+bool AsyncSearch::takeInfo(SearchInfo& info) {
+    std::lock_guard<std::mutex> lock(infoMutex);
+    if (!hasInfo) return false;
+    
+    info = latestInfo;
+    hasInfo = false;
+    return true;
+}
+
+SearchStats AsyncSearch::getStats() const {
+    if (isThinking()) return SearchStats();
+    return search.getStats();
+}
+
+bool AsyncSearch::takeResult(Move& move) {
+    if (isThinking() || isPondering() || !worker.joinable()) return false;
+    
+    worker.join();
+    if (!hasResult) return false;
+    
+    move = result;
+    hasResult = false;
+    
+    std::lock_guard<std::mutex> lock(infoMutex);
+    bool hasReply = latestInfo.pvLength >= 2 && latestInfo.pv[0] == result;
+    expectedReply = hasReply ? latestInfo.pv[1] : Move();
+    return true;
+}
+
+void AsyncSearch::clearHash() {
+    cancel();
+    search.clearHash();
+}
+
+void AsyncSearch::setHashSize(size_t megabytes) {
+    cancel();
+    search.setHashSize(megabytes);
+}
+
+void AsyncSearch::setThreads(int count) {
+    cancel();
+    search.setThreads(count);
+}
+
+void AsyncSearch::setBook(std::shared_ptr<const OpeningBook> book) {
+    cancel();
+    search.setBook(std::move(book));
+}
+
+void AsyncSearch::setNetwork(std::shared_ptr<const nnue::Network> network) {
+    cancel();
+    search.setNetwork(std::move(network));
+}
+
+void AsyncSearch::setBitbases(std::shared_ptr<const bitbase::Bitbases> tables) {
+    cancel();
+    search.setBitbases(std::move(tables));
+}
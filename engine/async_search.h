@@ -0,0 +1,83 @@
+#ifndef CHESS_ENGINE_ASYNC_SEARCH_H
+#define CHESS_ENGINE_ASYNC_SEARCH_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "search.h"
+
+// Runs getBestMove on a worker thread so the caller's loop keeps running.
+// The caller polls takeResult() for the finished move and can cancel() at
+// any point; a cancelled search's move is never handed back.
+class AsyncSearch {
+public:
+    explicit AsyncSearch(size_t hashMegabytes = 16);
+    ~AsyncSearch();
+    
+    AsyncSearch(const AsyncSearch&) = delete;
+    AsyncSearch& operator=(const AsyncSearch&) = delete;
+    
+    // Cancels any search still running, then starts one on a copy of
+    // `position`.
+    void start(const Board& position, const SearchLimits& limits);
+    
+    // Starts a search of `position` that ignores the time and node limits
+    // until ponderHit() (see Search::setPonderFlag); until then it has no
+    // result to take.
+    // Use it on the position after the opponent's expected reply, while the
+    // opponent thinks.
+    void ponder(const Board& position, const SearchLimits& limits);
+    
+    // The expected reply was played: the running search carries on and
+    // finishes within `limits`, counted from when it started.
+    void ponderHit() { pondering.store(false); }
+    
+    bool isPondering() const { return pondering.load(std::memory_order_acquire); }
+    
+    // Raises the stop flag and waits for the worker to unwind, which takes
+    // at most a few thousand nodes.
+    void cancel();
+    
+    bool isThinking() const { return thinking.load(std::memory_order_acquire); }
+    
+    // True exactly once per completed search, with its move.
+    bool takeResult(Move& move);
+    
+    // The reply the last search whose result was taken expects to its move
+    // (the second move of its principal variation); null if it has none.
+    Move getExpectedReply() const { return expectedReply; }
+    
+    // The latest iteration report of the running search; true if there is
+    // one the caller has not seen yet.
+    bool takeInfo(SearchInfo& info);
+    
+    // Totals of the last finished search, over all its threads.
+    SearchStats getStats() const;
+    
+    // Only safe while no search is running, so both cancel first.
+    void clearHash();
+    void setHashSize(size_t megabytes);
+    void setThreads(int count);
+    void setBook(std::shared_ptr<const OpeningBook> book);
+    void setNetwork(std::shared_ptr<const nnue::Network> network);
+    void setBitbases(std::shared_ptr<const bitbase::Bitbases> tables);
+
+private:
+    void launch(const Board& position, const SearchLimits& limits, bool ponderFirst);
+    
+    Search search;
+    std::thread worker;
+    std::atomic<bool> stopFlag;
+    std::atomic<bool> thinking;
+    std::atomic<bool> pondering;
+    bool hasResult;
+    Move result;
+    Move expectedReply;
+    
+    std::mutex infoMutex;
+    SearchInfo latestInfo;
+    bool hasInfo;
+};
+
+#endif
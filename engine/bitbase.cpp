@@ -0,0 +1,288 @@
+#include "bitbase.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "board.h"
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bitbase {
+
+namespace {
+
+// Each side's pieces after its king, in slot order.
+const PieceType slotOrder[5] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+
+uint64_t readLittleEndian(const unsigned char* bytes, int count) {
+    uint64_t value = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+int slotRank(PieceType type) {
+    return int(std::find(slotOrder, slotOrder + 5, type) - slotOrder);
+}
+
+uint32_t pieceKey(const Piece& piece) {
+    if (piece.type == KING) return 0;
+    return uint32_t(1) << (3 * (piece.type - PAWN) + (piece.color == BLACK ? 15 : 0));
+}
+
+}
+
+bool setupFrom(const Board& board, Setup& setup) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    if (popCount(bitboards.occupied) > MAX_PIECES || board.getCastlingRights() != 0) return false;
+    
+    PieceColor side = board.getCurrentPlayer();
+    int enPassant = board.getEnPassantSquare();
+    if (enPassant >= 0 && (attackTables.pawn[opponent(side)][enPassant] & bitboards.pieces[side][PAWN])) return false;
+    
+    setup.count = 0;
+    setup.sideToMove = side;
+    for (Bitboard occupied = bitboards.occupied; occupied;) {
+        int square = popLSB(occupied);
+        setup.pieces[setup.count] = board.pieceAt(square);
+        setup.squares[setup.count++] = square;
+    }
+    return true;
+}
+
+uint32_t materialKey(const Setup& setup) {
+    uint32_t key = 0;
+    for (int i = 0; i < setup.count; i++) {
+        key += pieceKey(setup.pieces[i]);
+    }
+    return key;
+}
+
+void flipColors(Setup& setup) {
+    for (int i = 0; i < setup.count; i++) {
+        setup.pieces[i].color = opponent(setup.pieces[i].color);
+        setup.squares[i] ^= 56;
+    }
+    setup.sideToMove = opponent(setup.sideToMove);
+}
+
+bool TableLayout::parse(const std::string& text) {
+    size_t second = text.find('K', 1);
+    if (text.size() > size_t(MAX_PIECES) || text.empty() || text[0] != 'K' || second == std::string::npos) {
+        return false;
+    }
+    
+    count = 2;
+    pieces[0] = Piece(KING, WHITE);
+    pieces[1] = Piece(KING, BLACK);
+    for (size_t i = 1; i < text.size(); i++) {
+        if (i == second) continue;
+        const char* letter = std::strchr("PRNBQ", text[i]);
+        if (!letter || *letter == '\0') return false;
+        pieces[count++] = Piece(PieceType(PAWN + (letter - "PRNBQ")), i < second ? WHITE : BLACK);
+    }
+    std::sort(pieces + 2, pieces + count, [](const Piece& a, const Piece& b) {
+        if (a.color != b.color) return a.color == WHITE;
+        return slotRank(a.type) < slotRank(b.type);
+    });
+    
+    name = text;
+    key = 0;
+    pawns = false;
+    size = 2 * 64;
+    for (int slot = 0; slot < count; slot++) {
+        key += pieceKey(pieces[slot]);
+        if (slot >= 2) size *= (pieces[slot].type == PAWN) ? 48 : 64;
+        if (pieces[slot].type == PAWN) pawns = true;
+    }
+    kingSquares = pawns ? 32 : 16;
+    size *= kingSquares;
+    return true;
+}
+
+uint64_t TableLayout::index(const int* squares, PieceColor sideToMove) const {
+    // Pawns only allow the file mirror, as they move along files.
+    int king = squares[0];
+    int mirror = (king % 8 >= 4) ? 7 : 0;
+    if (!pawns && king / 8 < 4) mirror ^= 56;
+    
+    int mirrored[MAX_PIECES];
+    for (int slot = 0; slot < count; slot++) {
+        mirrored[slot] = squares[slot] ^ mirror;
+    }
+    for (int slot = 3; slot < count; slot++) {
+        if (pieces[slot].type == pieces[slot - 1].type && pieces[slot].color == pieces[slot - 1].color &&
+            mirrored[slot] < mirrored[slot - 1]) {
+            std::swap(mirrored[slot], mirrored[slot - 1]);
+        }
+    }
+    
+    king = mirrored[0];
+    int kingSlot = pawns ? (king / 8) * 4 + king % 8 : (king / 8 - 4) * 4 + king % 8;
+    uint64_t result = (uint64_t(sideToMove == BLACK) * kingSquares + kingSlot) * 64 + mirrored[1];
+    for (int slot = 2; slot < count; slot++) {
+        if (pieces[slot].type == PAWN) result = result * 48 + (mirrored[slot] - 8);
+        else result = result * 64 + mirrored[slot];
+    }
+    return result;
+}
+
+uint64_t TableLayout::index(const Setup& setup) const {
+    int squares[MAX_PIECES];
+    bool used[MAX_PIECES] = {};
+    for (int slot = 0; slot < count; slot++) {
+        for (int i = 0; i < setup.count; i++) {
+            if (!used[i] && setup.pieces[i].type == pieces[slot].type && setup.pieces[i].color == pieces[slot].color) {
+                used[i] = true;
+                squares[slot] = setup.squares[i];
+                break;
+            }
+        }
+    }
+    return index(squares, setup.sideToMove);
+}
+
+void TableLayout::decode(uint64_t index, int* squares, PieceColor& sideToMove) const {
+    for (int slot = count - 1; slot >= 2; slot--) {
+        if (pieces[slot].type == PAWN) {
+            squares[slot] = int(index % 48) + 8;
+            index /= 48;
+        } else {
+            squares[slot] = int(index % 64);
+            index /= 64;
+        }
+    }
+    squares[1] = int(index % 64);
+    index /= 64;
+    int kingSlot = int(index % kingSquares);
+    squares[0] = pawns ? (kingSlot / 4) * 8 + kingSlot % 4 : (kingSlot / 4 + 4) * 8 + kingSlot % 4;
+    sideToMove = (index / kingSquares != 0) ? BLACK : WHITE;
+}
+
+Bitbases::Bitbases() : data(nullptr), length(0) {}
+
+Bitbases::~Bitbases() {
+    close();
+}
+
+#ifdef _WIN32
+
+// No mmap here; the file is read into memory instead.
+bool Bitbases::open(const std::string& path) {
+    close();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() < HEADER_SIZE) return false;
+    
+    unsigned char* copy = new unsigned char[bytes.size()];
+    std::copy(bytes.begin(), bytes.end(), copy);
+    data = copy;
+    length = bytes.size();
+    return readDirectory();
+}
+
+void Bitbases::close() {
+    delete[] data;
+    data = nullptr;
+    length = 0;
+    tables.clear();
+}
+
+#else
+
+bool Bitbases::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    
+    data = static_cast<const unsigned char*>(mapping);
+    length = size_t(info.st_size);
+    return readDirectory();
+}
+
+void Bitbases::close() {
+    if (data) munmap(const_cast<unsigned char*>(data), length);
+    data = nullptr;
+    length = 0;
+    tables.clear();
+}
+
+#endif
+
+bool Bitbases::readDirectory() {
+    uint64_t count = readLittleEndian(data + 8, 4);
+    if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0 || HEADER_SIZE + count * DIRECTORY_ENTRY_SIZE > length) {
+        close();
+        return false;
+    }
+    
+    for (uint64_t i = 0; i < count; i++) {
+        const unsigned char* entry = data + HEADER_SIZE + i * DIRECTORY_ENTRY_SIZE;
+        Table table;
+        std::string name(reinterpret_cast<const char*>(entry), strnlen(reinterpret_cast<const char*>(entry), NAME_SIZE));
+        uint64_t offset = readLittleEndian(entry + NAME_SIZE, 8);
+        uint64_t positions = readLittleEndian(entry + NAME_SIZE + 8, 8);
+        if (!table.layout.parse(name) || positions != table.layout.getSize() || offset > length ||
+            (positions + 3) / 4 > length - offset) {
+            close();
+            return false;
+        }
+        table.bits = data + offset;
+        tables.push_back(table);
+    }
+    std::sort(tables.begin(), tables.end(), [](const Table& a, const Table& b) {
+        return a.layout.getMaterialKey() < b.layout.getMaterialKey();
+    });
+    return true;
+}
+
+const Bitbases::Table* Bitbases::find(uint32_t key) const {
+    auto table = std::lower_bound(tables.begin(), tables.end(), key, [](const Table& entry, uint32_t k) {
+        return entry.layout.getMaterialKey() < k;
+    });
+    return (table != tables.end() && table->layout.getMaterialKey() == key) ? &*table : nullptr;
+}
+
+bool Bitbases::probe(const Board& board, Result& result) const {
+    Setup setup;
+    return data && setupFrom(board, setup) && probe(setup, result);
+}
+
+bool Bitbases::probe(const Setup& setup, Result& result) const {
+    if (setup.count == 2) {
+        result = DRAW;
+        return true;
+    }
+    const Table* table = find(materialKey(setup));
+    if (table) {
+        result = resultAt(table->bits, table->layout.index(setup));
+        return true;
+    }
+    Setup flipped = setup;
+    flipColors(flipped);
+    table = find(materialKey(flipped));
+    if (!table) return false;
+    result = resultAt(table->bits, table->layout.index(flipped));
+    return true;
+}
+
+}
@@ -0,0 +1,153 @@
+#ifndef CHESS_ENGINE_BITBASE_H
+#define CHESS_ENGINE_BITBASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+class Board;
+
+// Win/draw/loss tables for every ending with up to four pieces, kings
+// included, built by tools/bitbasegen and mapped read-only from one file
+// like the opening book.
+//
+// A table holds one material, named from the stronger side, e.g. "KRPK" or
+// "KQKR", with White as that side; a position with the colours the other
+// way round is looked up flipped. Positions are numbered by the squares of
+// the pieces in the table's order (see TableLayout) and the side to move,
+// and each takes 2 bits. Castling, en passant and the fifty-move rule are
+// left out, so a position is only probed without castling rights and
+// without an en passant capture on the board.
+//
+// File: a 16-byte header (the magic, then the number of tables as a 32-bit
+// integer), one 32-byte directory entry per table (its name, zero-padded to
+// 16 bytes, then the 64-bit offset and position count of its bits), then
+// the tables, each 64-byte aligned. Four positions to a byte, the first in
+// the low bits. All numbers are little-endian.
+namespace bitbase {
+
+const int MAX_PIECES = 4;
+
+// For the side to move; also the 2-bit code in the file.
+enum Result {
+    DRAW = 0,
+    WIN = 1,
+    LOSS = 2
+};
+
+const char MAGIC[8] = {'E', 'C', 'B', 'I', 'T', 'B', '0', '1'};
+const size_t HEADER_SIZE = 16;
+const size_t DIRECTORY_ENTRY_SIZE = 32;
+const size_t NAME_SIZE = 16;
+
+// The pieces of a position the tables can hold, in any order.
+struct Setup {
+    int count;
+    Piece pieces[MAX_PIECES];
+    int squares[MAX_PIECES];
+    PieceColor sideToMove;
+    
+    Setup() : count(0), squares(), sideToMove(WHITE) {}
+};
+
+// False if the board has more than MAX_PIECES pieces, castling rights or
+// an en passant capture.
+bool setupFrom(const Board& board, Setup& setup);
+
+// Identifies the material of a setup as it stands: a count of each type
+// per colour. Tables are looked up by the key of their own material.
+uint32_t materialKey(const Setup& setup);
+
+// Swaps the colours and mirrors the ranks, which keeps the result.
+void flipColors(Setup& setup);
+
+// How one table numbers its positions. The pieces (slots) go White king,
+// Black king, White's other pieces, then Black's, each side's from queen
+// down to pawn. The board is first mirrored so the White king is on files
+// a-d and, without pawns, on ranks 1-4 too, and identical pieces are put
+// in ascending square order. The index is then
+//
+//   ((side to move * king squares + White king) * 64 + Black king) * range 2 + square 2 ...
+//
+// counting the White king only over the squares it is mirrored onto, and
+// the other pieces over all 64 squares, or the 48 a pawn can stand on.
+// Every position has one index, while some indices (pieces on one square,
+// identical pieces out of order) have no position.
+class TableLayout {
+public:
+    TableLayout() : count(0), pawns(false), key(0), size(0), kingSquares(0) {}
+    
+    // From a name such as "KRPK"; false for anything else.
+    bool parse(const std::string& name);
+    
+    const std::string& getName() const { return name; }
+    int getPieceCount() const { return count; }
+    const Piece& getPiece(int slot) const { return pieces[slot]; }
+    bool hasPawns() const { return pawns; }
+    uint32_t getMaterialKey() const { return key; }
+    uint64_t getSize() const { return size; }
+    
+    // Index of the position with the table's pieces on `squares`, in slot
+    // order.
+    uint64_t index(const int* squares, PieceColor sideToMove) const;
+    // Index of a setup of this material, pieces in any order.
+    uint64_t index(const Setup& setup) const;
+    // The squares an index stands for; only indices that index() gives
+    // back for them are positions.
+    void decode(uint64_t index, int* squares, PieceColor& sideToMove) const;
+
+private:
+    std::string name;
+    int count;
+    Piece pieces[MAX_PIECES];
+    bool pawns;
+    uint32_t key;
+    uint64_t size;
+    int kingSquares;  // the White king's, after mirroring
+};
+
+// The result stored for `index` in a table's packed bits.
+inline Result resultAt(const unsigned char* bits, uint64_t index) {
+    return Result((bits[index >> 2] >> (2 * (index & 3))) & 3);
+}
+
+class Bitbases {
+public:
+    Bitbases();
+    ~Bitbases();
+    
+    Bitbases(const Bitbases&) = delete;
+    Bitbases& operator=(const Bitbases&) = delete;
+    
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    size_t getTableCount() const { return tables.size(); }
+    
+    // The result for the side to move, if the tables cover the position.
+    // Two bare kings are a draw without a table.
+    bool probe(const Board& board, Result& result) const;
+    bool probe(const Setup& setup, Result& result) const;
+
+private:
+    struct Table {
+        TableLayout layout;
+        const unsigned char* bits;
+    };
+    
+    // Checks the header and directory of the file just opened and lists
+    // its tables; closes the file if they are damaged.
+    bool readDirectory();
+    const Table* find(uint32_t key) const;
+    
+    const unsigned char* data;
+    size_t length;
+    std::vector<Table> tables;  // by material key
+};
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "bitboard.h"
+#include "types.h"
+
+constexpr AttackTables::AttackTables() : knight(), king(), pawn(), rays(), between(), line() {
+    const int rayStep[8][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1},
+                               {-1, 0}, {0, -1}, {-1, -1}, {-1, 1}};
+    const int knightStep[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2},
+                                  {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+
+    for (int square = 0; square < 64; square++) {
+        int row = square / 8;
+        int col = square % 8;
+
+        for (int i = 0; i < 8; i++) {
+            if (onBoard(row + knightStep[i][0], col + knightStep[i][1])) {
+                knight[square] |= squareBB(squareOf(row + knightStep[i][0], col + knightStep[i][1]));
+            }
+            if (onBoard(row + rayStep[i][0], col + rayStep[i][1])) {
+                king[square] |= squareBB(squareOf(row + rayStep[i][0], col + rayStep[i][1]));
+            }
+
+            int r = row + rayStep[i][0];
+            int c = col + rayStep[i][1];
+            while (onBoard(r, c)) {
+                rays[i][square] |= squareBB(squareOf(r, c));
+                r += rayStep[i][0];
+                c += rayStep[i][1];
+            }
+        }
+
+        for (int dc = -1; dc <= 1; dc += 2) {
+            if (onBoard(row - 1, col + dc)) pawn[WHITE][square] |= squareBB(squareOf(row - 1, col + dc));
+            if (onBoard(row + 1, col + dc)) pawn[BLACK][square] |= squareBB(squareOf(row + 1, col + dc));
+        }
+    }
+
+    // Opposite directions differ in bit 2 (SOUTH and NORTH, EAST and WEST, ...).
+    for (int from = 0; from < 64; from++) {
+        for (int d = 0; d < 8; d++) {
+            for (int to = 0; to < 64; to++) {
+                if (rays[d][from] & squareBB(to)) {
+                    between[from][to] = rays[d][from] & ~rays[d][to] & ~squareBB(to);
+                    line[from][to] = rays[d][from] | rays[d ^ 4][from] | squareBB(from);
+                }
+            }
+        }
+    }
+}
+
+constexpr AttackTables attackTables;
+
+// a8 (square 0): knight on b6 and c7, king on b8, a7 and b7.
+static_assert(attackTables.knight[0] == (squareBB(10) | squareBB(17)), "knight table");
+static_assert(attackTables.king[0] == (squareBB(1) | squareBB(8) | squareBB(9)), "king table");
+static_assert(attackTables.pawn[WHITE][52] == (squareBB(43) | squareBB(45)), "pawn table");
+static_assert(attackTables.between[56][63] == 0x7E00000000000000ULL, "between table");
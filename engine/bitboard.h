@@ -0,0 +1,116 @@
+#ifndef CHESS_ENGINE_BITBOARD_H
+#define CHESS_ENGINE_BITBOARD_H
+
+#include <cstdint>
+
+#ifdef CHESS_USE_PEXT
+#include <immintrin.h>
+#endif
+
+// Squares are numbered row * 8 + col, so square 0 is a8 and square 63 is h1,
+// matching the Position coordinates used by the board and the UI.
+typedef uint64_t Bitboard;
+
+constexpr int squareOf(int row, int col) { return row * 8 + col; }
+constexpr Bitboard squareBB(int square) { return Bitboard(1) << square; }
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+inline int msb(Bitboard b) { return 63 - __builtin_clzll(b); }
+
+// Without the POPCNT instruction the builtin becomes a library call that
+// looks up each byte in a table; counting in parallel within the register
+// (SWAR) is several times faster than that.
+inline int popCount(Bitboard b) {
+#ifdef __POPCNT__
+    return __builtin_popcountll(b);
+#else
+    b = b - ((b >> 1) & 0x5555555555555555ULL);
+    b = (b & 0x3333333333333333ULL) + ((b >> 2) & 0x3333333333333333ULL);
+    b = (b + (b >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return int((b * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+inline int popLSB(Bitboard& b) {
+    int square = lsb(b);
+    b &= b - 1;
+    return square;
+}
+
+// The first four directions step towards higher square numbers, so the
+// nearest blocker on those rays is the lowest set bit (see rayAttacks).
+enum Direction {
+    SOUTH = 0,
+    EAST = 1,
+    SOUTH_EAST = 2,
+    SOUTH_WEST = 3,
+    NORTH = 4,
+    WEST = 5,
+    NORTH_WEST = 6,
+    NORTH_EAST = 7
+};
+
+// Built by a constexpr constructor, so the tables are constant data in
+// the binary and nothing is computed at startup.
+struct AttackTables {
+    Bitboard knight[64];
+    Bitboard king[64];
+    Bitboard pawn[3][64];  // [color][square], capture squares only
+    Bitboard rays[8][64];  // [direction][square], up to the board edge
+    Bitboard between[64][64];  // squares strictly between two aligned squares
+    Bitboard line[64][64];     // the whole line through two aligned squares
+
+    constexpr AttackTables();
+
+    static constexpr bool onBoard(int row, int col) {
+        return row >= 0 && row < 8 && col >= 0 && col < 8;
+    }
+};
+
+extern const AttackTables attackTables;
+
+// Rook and bishop attacks are looked up in one shared table. For a given
+// square, the occupied squares that can block (`mask`) map to a distinct
+// index: by a multiply and shift with a magic number, or with PEXT when the
+// engine is built with CHESS_USE_PEXT. tools/genmagics finds the magic
+// numbers, checks them against every blocker set and writes out all the
+// tables at build time.
+struct SliderMagic {
+    Bitboard mask;
+    Bitboard magic;
+    unsigned offset;  // first entry of this square in sliderAttacks
+    unsigned shift;
+};
+
+const int SLIDER_TABLE_SIZE = 102400 + 5248;  // rook entries, then bishop
+
+extern const SliderMagic rookMagics[64];
+extern const SliderMagic bishopMagics[64];
+extern const Bitboard sliderAttacks[SLIDER_TABLE_SIZE];
+
+inline Bitboard sliderLookup(const SliderMagic& entry, Bitboard occupied) {
+#ifdef CHESS_USE_PEXT
+    return sliderAttacks[entry.offset + _pext_u64(occupied, entry.mask)];
+#else
+    return sliderAttacks[entry.offset + (((occupied & entry.mask) * entry.magic) >> entry.shift)];
+#endif
+}
+
+inline Bitboard rayAttacks(int direction, int square, Bitboard occupied) {
+    Bitboard attacks = attackTables.rays[direction][square];
+    Bitboard blockers = attacks & occupied;
+    if (blockers) {
+        int blocker = (direction < NORTH) ? lsb(blockers) : msb(blockers);
+        attacks ^= attackTables.rays[direction][blocker];
+    }
+    return attacks;
+}
+
+inline Bitboard rookAttacks(int square, Bitboard occupied) {
+    return sliderLookup(rookMagics[square], occupied);
+}
+
+inline Bitboard bishopAttacks(int square, Bitboard occupied) {
+    return sliderLookup(bishopMagics[square], occupied);
+}
+
+#endif
@@ -0,0 +1,426 @@
+#include "board.h"
+
+#include <cctype>
+#include <sstream>
+
+#include "movegen.h"
+#include "psqt.h"
+#include "zobrist.h"
+
+namespace {
+
+// Rights lost when a move starts or ends on the square: the king's or a
+// rook's home square.
+int castlingMask(int square) {
+    switch (square) {
+        case 0: return BLACK_QUEENSIDE;
+        case 4: return BLACK_KINGSIDE | BLACK_QUEENSIDE;
+        case 7: return BLACK_KINGSIDE;
+        case 56: return WHITE_QUEENSIDE;
+        case 60: return WHITE_KINGSIDE | WHITE_QUEENSIDE;
+        case 63: return WHITE_KINGSIDE;
+        default: return 0;
+    }
+}
+
+}
+
+Board::Board()
+    : currentPlayer(WHITE), castlingRights(0), enPassantSquare(-1), halfmoveClock(0), fullmoveNumber(1),
+      key(0), pawnKey(0), middlegameScore(0), endgameScore(0), phase(0), network(nullptr) {
+    initializeBoard();
+}
+
+void Board::clear() {
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            squares[i][j] = Piece();
+        }
+    }
+    bitboards.clear();
+    currentPlayer = WHITE;
+    castlingRights = 0;
+    enPassantSquare = -1;
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+    key = 0;
+    pawnKey = 0;
+    middlegameScore = endgameScore = phase = 0;
+    accumulator.valid[WHITE] = accumulator.valid[BLACK] = false;
+    moveHistory.clear();
+}
+
+void Board::initializeBoard() {
+    // Clear board
+    clear();
+    
+    // Place pawns
+    for (int j = 0; j < 8; j++) {
+        setPiece(1, j, Piece(PAWN, BLACK));
+        setPiece(6, j, Piece(PAWN, WHITE));
+    }
+    
+    // Place other pieces
+    PieceType backRow[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+    
+    for (int j = 0; j < 8; j++) {
+        setPiece(0, j, Piece(backRow[j], BLACK));
+        setPiece(7, j, Piece(backRow[j], WHITE));
+    }
+    
+    castlingRights = ALL_CASTLING;
+    key ^= zobrist.castling[castlingRights];
+}
+
+bool Board::loadFEN(const std::string& fen) {
+    std::istringstream in(fen);
+    std::string placement, side, castling = "-", enPassant = "-";
+    int halfmoves = 0, fullmoves = 1;
+    if (!(in >> placement >> side)) return false;
+    // EPD puts operations where FEN has the move counters.
+    in >> castling >> enPassant;
+    if (!(in >> halfmoves >> fullmoves)) {
+        halfmoves = 0;
+        fullmoves = 1;
+    }
+    
+    Piece parsed[8][8];
+    int row = 0, col = 0;
+    for (char ch : placement) {
+        if (ch == '/') {
+            if (col != 8) return false;
+            row++;
+            col = 0;
+        } else if (ch >= '1' && ch <= '8') {
+            col += ch - '0';
+        } else {
+            PieceType type;
+            switch (std::tolower(static_cast<unsigned char>(ch))) {
+                case 'p': type = PAWN; break;
+                case 'r': type = ROOK; break;
+                case 'n': type = KNIGHT; break;
+                case 'b': type = BISHOP; break;
+                case 'q': type = QUEEN; break;
+                case 'k': type = KING; break;
+                default: return false;
+            }
+            if (row >= 8 || col >= 8) return false;
+            // A pawn on either back rank would move off the board.
+            if (type == PAWN && (row == 0 || row == 7)) return false;
+            parsed[row][col++] = Piece(type, std::isupper(static_cast<unsigned char>(ch)) ? WHITE : BLACK);
+        }
+        if (col > 8) return false;
+    }
+    if (row != 7 || col != 8) return false;
+    if (side != "w" && side != "b") return false;
+    
+    int rights = 0;
+    if (castling != "-") {
+        for (char ch : castling) {
+            switch (ch) {
+                case 'K': rights |= WHITE_KINGSIDE; break;
+                case 'Q': rights |= WHITE_QUEENSIDE; break;
+                case 'k': rights |= BLACK_KINGSIDE; break;
+                case 'q': rights |= BLACK_QUEENSIDE; break;
+                default: return false;
+            }
+        }
+    }
+    int epSquare = -1;
+    if (enPassant != "-") {
+        if (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h' ||
+            (enPassant[1] != '3' && enPassant[1] != '6')) {
+            return false;
+        }
+        epSquare = squareOf('8' - enPassant[1], enPassant[0] - 'a');
+    }
+    
+    // A position that fails the checks below leaves the board as it was.
+    Board previous = *this;
+    clear();
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            setPiece(i, j, parsed[i][j]);
+        }
+    }
+    if (popCount(bitboards.pieces[WHITE][KING]) != 1 || popCount(bitboards.pieces[BLACK][KING]) != 1) {
+        *this = previous;
+        return false;
+    }
+    
+    if (side == "b") switchPlayer();
+    
+    // The side that just moved cannot have left its king in check.
+    PieceColor waiting = opponent(currentPlayer);
+    int waitingKing = lsb(bitboards.pieces[waiting][KING]);
+    if (attackersTo(*this, waitingKing, bitboards.occupied) & bitboards.colors[currentPlayer]) {
+        *this = previous;
+        return false;
+    }
+    
+    // Rights whose king or rook has left home are dropped, as are en
+    // passant squares no pawn can take on.
+    const int homes[4][2] = {{60, 63}, {60, 56}, {4, 7}, {4, 0}};
+    for (int i = 0; i < 4; i++) {
+        PieceColor color = (i < 2) ? WHITE : BLACK;
+        const Piece& king = pieceAt(homes[i][0]);
+        const Piece& rook = pieceAt(homes[i][1]);
+        if (king.type != KING || king.color != color || rook.type != ROOK || rook.color != color) {
+            rights &= ~(1 << i);
+        }
+    }
+    castlingRights = rights;
+    key ^= zobrist.castling[castlingRights];
+    if (epSquare >= 0 &&
+        (attackTables.pawn[opponent(currentPlayer)][epSquare] & bitboards.pieces[currentPlayer][PAWN])) {
+        enPassantSquare = epSquare;
+        key ^= zobrist.enPassant[epSquare % 8];
+    }
+    halfmoveClock = halfmoves;
+    fullmoveNumber = fullmoves;
+    return true;
+}
+
+std::string Board::toFEN() const {
+    const char letters[7] = {' ', 'p', 'r', 'n', 'b', 'q', 'k'};
+    std::string fen;
+    for (int row = 0; row < 8; row++) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            const Piece& piece = squares[row][col];
+            if (piece.type == EMPTY) {
+                empty++;
+                continue;
+            }
+            if (empty > 0) fen += char('0' + empty);
+            empty = 0;
+            char letter = letters[piece.type];
+            fen += (piece.color == WHITE) ? char(std::toupper(static_cast<unsigned char>(letter))) : letter;
+        }
+        if (empty > 0) fen += char('0' + empty);
+        if (row < 7) fen += '/';
+    }
+    
+    fen += (currentPlayer == WHITE) ? " w " : " b ";
+    std::string castling;
+    if (castlingRights & WHITE_KINGSIDE) castling += 'K';
+    if (castlingRights & WHITE_QUEENSIDE) castling += 'Q';
+    if (castlingRights & BLACK_KINGSIDE) castling += 'k';
+    if (castlingRights & BLACK_QUEENSIDE) castling += 'q';
+    fen += castling.empty() ? "-" : castling;
+    if (enPassantSquare >= 0) {
+        fen += ' ';
+        fen += char('a' + enPassantSquare % 8);
+        fen += char('8' - enPassantSquare / 8);
+    } else {
+        fen += " -";
+    }
+    return fen + " " + std::to_string(halfmoveClock) + " " + std::to_string(fullmoveNumber);
+}
+
+// Every board write goes through here so the bitboards never drift
+// from the Piece array.
+void Board::setPiece(int row, int col, Piece piece) {
+    int square = squareOf(row, col);
+    const Piece& old = squares[row][col];
+    if (network) network->update(bitboards, square, old, piece, accumulator);
+    if (old.type != EMPTY) {
+        bitboards.remove(square, old);
+        key ^= zobrist.pieces[old.color][old.type][square];
+        if (old.type == PAWN) pawnKey ^= zobrist.pieces[old.color][PAWN][square];
+        middlegameScore -= psqt::tables.middlegame[old.color][old.type][square];
+        endgameScore -= psqt::tables.endgame[old.color][old.type][square];
+        phase -= psqt::phaseWeight[old.type];
+    }
+    squares[row][col] = piece;
+    if (piece.type != EMPTY) {
+        bitboards.put(square, piece);
+        key ^= zobrist.pieces[piece.color][piece.type][square];
+        if (piece.type == PAWN) pawnKey ^= zobrist.pieces[piece.color][PAWN][square];
+        middlegameScore += psqt::tables.middlegame[piece.color][piece.type][square];
+        endgameScore += psqt::tables.endgame[piece.color][piece.type][square];
+        phase += psqt::phaseWeight[piece.type];
+    }
+}
+
+void Board::setNetwork(const nnue::Network* net) {
+    network = net;
+    accumulator.valid[WHITE] = accumulator.valid[BLACK] = false;
+}
+
+const nnue::Accumulator& Board::getAccumulator() const {
+    for (PieceColor perspective : {WHITE, BLACK}) {
+        if (!accumulator.valid[perspective]) network->refresh(bitboards, perspective, accumulator);
+    }
+    return accumulator;
+}
+
+uint64_t Board::computeKey() const {
+    uint64_t result = 0;
+    for (int square = 0; square < 64; square++) {
+        const Piece& piece = pieceAt(square);
+        if (piece.type != EMPTY) {
+            result ^= zobrist.pieces[piece.color][piece.type][square];
+        }
+    }
+    if (currentPlayer == BLACK) result ^= zobrist.side;
+    result ^= zobrist.castling[castlingRights];
+    if (enPassantSquare >= 0) result ^= zobrist.enPassant[enPassantSquare % 8];
+    return result;
+}
+
+void Board::switchPlayer() {
+    currentPlayer = opponent(currentPlayer);
+    key ^= zobrist.side;
+}
+
+void Board::makeMove(Move move) {
+    MoveRecord record;
+    makeTemporaryMove(move, record);
+    moveHistory.push_back(record);
+}
+
+void Board::makeMove(int fromRow, int fromCol, int toRow, int toCol) {
+    int from = squareOf(fromRow, fromCol);
+    int to = squareOf(toRow, toCol);
+    const Piece& piece = pieceAt(from);
+    
+    if (piece.type == PAWN && (toRow == 0 || toRow == 7)) {
+        makeMove(Move(from, to, PROMOTION, QUEEN));
+    } else if (piece.type == PAWN && to == enPassantSquare) {
+        makeMove(Move(from, to, EN_PASSANT));
+    } else if (piece.type == KING && (toCol - fromCol == 2 || fromCol - toCol == 2)) {
+        makeMove(Move(from, to, CASTLING));
+    } else {
+        makeMove(Move(from, to));
+    }
+}
+
+void Board::undoLastMove() {
+    if (moveHistory.empty()) return;
+    
+    MoveRecord lastMove = moveHistory.back();
+    moveHistory.pop_back();
+    
+    undoTemporaryMove(lastMove);
+}
+
+void Board::makeTemporaryMove(Move move, MoveRecord& record) {
+    int from = move.from();
+    int to = move.to();
+    record.move = move;
+    record.piece = pieceAt(from);
+    record.captured = pieceAt(to);
+    record.key = key;
+    record.castlingRights = castlingRights;
+    record.enPassantSquare = enPassantSquare;
+    record.halfmoveClock = halfmoveClock;
+    
+    if (enPassantSquare >= 0) {
+        key ^= zobrist.enPassant[enPassantSquare % 8];
+        enPassantSquare = -1;
+    }
+    
+    switch (move.flag()) {
+        case EN_PASSANT: {
+            // The captured pawn stands beside the mover, not on the target.
+            int capture = (from & ~7) | (to & 7);
+            record.captured = pieceAt(capture);
+            setSquare(capture, Piece());
+            setSquare(to, record.piece);
+            break;
+        }
+        case CASTLING: {
+            bool kingside = (to & 7) == 6;
+            int rookFrom = (from & ~7) | (kingside ? 7 : 0);
+            int rookTo = (from & ~7) | (kingside ? 5 : 3);
+            setSquare(rookTo, pieceAt(rookFrom));
+            setSquare(rookFrom, Piece());
+            setSquare(to, record.piece);
+            break;
+        }
+        case PROMOTION:
+            setSquare(to, Piece(move.promotion(), record.piece.color));
+            break;
+        default:
+            setSquare(to, record.piece);
+            break;
+    }
+    setSquare(from, Piece());
+    
+    int rights = castlingRights & ~(castlingMask(from) | castlingMask(to));
+    if (rights != castlingRights) {
+        key ^= zobrist.castling[castlingRights] ^ zobrist.castling[rights];
+        castlingRights = rights;
+    }
+    
+    PieceColor enemy = opponent(record.piece.color);
+    if (record.piece.type == PAWN && (to - from == 16 || from - to == 16)) {
+        int skipped = (from + to) / 2;
+        if (attackTables.pawn[record.piece.color][skipped] & bitboards.pieces[enemy][PAWN]) {
+            enPassantSquare = skipped;
+            key ^= zobrist.enPassant[skipped % 8];
+        }
+    }
+    
+    bool irreversible = record.piece.type == PAWN || record.captured.type != EMPTY;
+    halfmoveClock = irreversible ? 0 : halfmoveClock + 1;
+    if (record.piece.color == BLACK) fullmoveNumber++;
+    switchPlayer();
+}
+
+void Board::undoTemporaryMove(const MoveRecord& record) {
+    int from = record.move.from();
+    int to = record.move.to();
+    
+    switch (record.move.flag()) {
+        case EN_PASSANT:
+            setSquare(to, Piece());
+            setSquare((from & ~7) | (to & 7), record.captured);
+            break;
+        case CASTLING: {
+            bool kingside = (to & 7) == 6;
+            int rookFrom = (from & ~7) | (kingside ? 7 : 0);
+            int rookTo = (from & ~7) | (kingside ? 5 : 3);
+            setSquare(rookFrom, pieceAt(rookTo));
+            setSquare(rookTo, Piece());
+            setSquare(to, Piece());
+            break;
+        }
+        default:
+            setSquare(to, record.captured);
+            break;
+    }
+    setSquare(from, record.piece);
+    
+    currentPlayer = record.piece.color;
+    if (currentPlayer == BLACK) fullmoveNumber--;
+    castlingRights = record.castlingRights;
+    enPassantSquare = record.enPassantSquare;
+    halfmoveClock = record.halfmoveClock;
+    key = record.key;
+}
+
+void Board::makeNullMove(MoveRecord& record) {
+    record.move = Move();
+    record.piece = Piece(EMPTY, currentPlayer);
+    record.captured = Piece();
+    record.key = key;
+    record.castlingRights = castlingRights;
+    record.enPassantSquare = enPassantSquare;
+    record.halfmoveClock = halfmoveClock;
+    
+    if (enPassantSquare >= 0) {
+        key ^= zobrist.enPassant[enPassantSquare % 8];
+        enPassantSquare = -1;
+    }
+    halfmoveClock++;
+    switchPlayer();
+}
+
+void Board::undoNullMove(const MoveRecord& record) {
+    currentPlayer = record.piece.color;
+    enPassantSquare = record.enPassantSquare;
+    halfmoveClock = record.halfmoveClock;
+    key = record.key;
+}
@@ -0,0 +1,135 @@
+#ifndef CHESS_ENGINE_BOARD_H
+#define CHESS_ENGINE_BOARD_H
+
+#include <string>
+#include <vector>
+
+#include "bitboard.h"
+#include "nnue.h"
+#include "types.h"
+
+// One mask per piece type and colour plus the occupancy sets, kept in step
+// with the Piece array by Board::setPiece.
+struct BitboardPosition {
+    Bitboard pieces[3][7];  // [color][type]
+    Bitboard colors[3];     // [color]
+    Bitboard occupied;
+
+    BitboardPosition() { clear(); }
+
+    void clear() {
+        for (int c = 0; c < 3; c++) {
+            colors[c] = 0;
+            for (int t = 0; t < 7; t++) {
+                pieces[c][t] = 0;
+            }
+        }
+        occupied = 0;
+    }
+
+    void put(int square, const Piece& piece) {
+        Bitboard bit = squareBB(square);
+        pieces[piece.color][piece.type] |= bit;
+        colors[piece.color] |= bit;
+        occupied |= bit;
+    }
+
+    void remove(int square, const Piece& piece) {
+        Bitboard bit = squareBB(square);
+        pieces[piece.color][piece.type] &= ~bit;
+        colors[piece.color] &= ~bit;
+        occupied &= ~bit;
+    }
+};
+
+// The game state shared by the window, the search and the command-line
+// tools. Row 0 is Black's back rank, as drawn on screen.
+class Board {
+public:
+    Board();
+    
+    void initializeBoard();
+    
+    // Reads a FEN or EPD position. Castling, en passant and the move
+    // counters are optional and default to none, none, 0 and 1. Each side
+    // must have exactly one king, no pawn may stand on the first or last
+    // rank and the side not to move must not be in check; otherwise the
+    // board is left unchanged and false returned.
+    bool loadFEN(const std::string& fen);
+    // The position as FEN, which loadFEN reads back to the same board.
+    std::string toFEN() const;
+    
+    const Piece& pieceAt(int row, int col) const { return squares[row][col]; }
+    const Piece& pieceAt(int square) const { return squares[square / 8][square % 8]; }
+    void setPiece(int row, int col, Piece piece);
+    
+    const BitboardPosition& getBitboards() const { return bitboards; }
+    PieceColor getCurrentPlayer() const { return currentPlayer; }
+    int getCastlingRights() const { return castlingRights; }
+    // The square a pawn just skipped, or -1. Only set while an enemy pawn
+    // stands ready to capture there, so it never splits otherwise equal
+    // positions in the hash table.
+    int getEnPassantSquare() const { return enPassantSquare; }
+    int getHalfmoveClock() const { return halfmoveClock; }
+    int getFullmoveNumber() const { return fullmoveNumber; }
+    const std::vector<MoveRecord>& getMoveHistory() const { return moveHistory; }
+    
+    // Zobrist key, updated incrementally by every board write and move.
+    uint64_t getKey() const { return key; }
+    uint64_t computeKey() const;
+    // The same keys over the pawns alone, for the evaluation's pawn table.
+    uint64_t getPawnKey() const { return pawnKey; }
+    
+    // Running piece-square totals (White positive) and game phase, kept up
+    // to date by setPiece the same way as the key.
+    int getMiddlegameScore() const { return middlegameScore; }
+    int getEndgameScore() const { return endgameScore; }
+    int getPhase() const { return phase; }
+    
+    // With a network set, every board write also updates the NNUE
+    // accumulators; null (the default) leaves them alone. The network must
+    // outlive the board's use of it.
+    void setNetwork(const nnue::Network* net);
+    const nnue::Network* getNetwork() const { return network; }
+    // Recomputes any perspective a king move or a new position left stale.
+    const nnue::Accumulator& getAccumulator() const;
+    
+    // Game moves, recorded in the move history. The square form works out
+    // castling, en passant and promotion (to a queen) from the pieces.
+    void makeMove(Move move);
+    void makeMove(int fromRow, int fromCol, int toRow, int toCol);
+    void undoLastMove();
+    
+    // Search moves. The caller keeps the record (on its own stack, so the
+    // search never allocates) and undoes moves in reverse order.
+    void makeTemporaryMove(Move move, MoveRecord& record);
+    void undoTemporaryMove(const MoveRecord& record);
+    
+    // Passes the turn, for null-move pruning in the search. Clears the en
+    // passant square; undoNullMove puts it back.
+    void makeNullMove(MoveRecord& record);
+    void undoNullMove(const MoveRecord& record);
+
+private:
+    void switchPlayer();
+    void setSquare(int square, Piece piece) { setPiece(square / 8, square % 8, piece); }
+    void clear();
+    
+    Piece squares[8][8];
+    BitboardPosition bitboards;
+    PieceColor currentPlayer;
+    int castlingRights;
+    int enPassantSquare;
+    int halfmoveClock;
+    int fullmoveNumber;
+    uint64_t key;
+    uint64_t pawnKey;
+    int middlegameScore;
+    int endgameScore;
+    int phase;
+    const nnue::Network* network;
+    mutable nnue::Accumulator accumulator;
+    std::vector<MoveRecord> moveHistory;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "book.h"
+
+#include "movegen.h"
+
+#ifdef _WIN32
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+uint64_t readBigEndian(const unsigned char* bytes, int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+void writeBigEndian(unsigned char* bytes, uint64_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        bytes[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+// Book squares count ranks from White's side; our rows start at rank 8.
+int bookSquare(int square) {
+    return (7 - square / 8) * 8 + square % 8;
+}
+
+const PieceType promotionPieces[5] = {EMPTY, KNIGHT, BISHOP, ROOK, QUEEN};
+
+}
+
+OpeningBook::OpeningBook() : data(nullptr), length(0) {}
+
+OpeningBook::~OpeningBook() {
+    close();
+}
+
+#ifdef _WIN32
+
+// No mmap here; the book is read into memory instead.
+bool OpeningBook::open(const std::string& path) {
+    close();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.empty()) return false;
+    
+    unsigned char* copy = new unsigned char[bytes.size()];
+    std::copy(bytes.begin(), bytes.end(), copy);
+    data = copy;
+    length = bytes.size();
+    return true;
+}
+
+void OpeningBook::close() {
+    delete[] data;
+    data = nullptr;
+    length = 0;
+}
+
+#else
+
+bool OpeningBook::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)ENTRY_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    
+    data = static_cast<const unsigned char*>(mapping);
+    length = size_t(info.st_size);
+    return true;
+}
+
+void OpeningBook::close() {
+    if (data) munmap(const_cast<unsigned char*>(data), length);
+    data = nullptr;
+    length = 0;
+}
+
+#endif
+
+uint64_t OpeningBook::keyAt(size_t index) const {
+    return readBigEndian(data + index * ENTRY_SIZE, 8);
+}
+
+int OpeningBook::probe(const Board& board, BookMove* moves, int maxMoves) const {
+    if (!data) return 0;
+    
+    // First entry with this key.
+    uint64_t key = board.getKey();
+    size_t low = 0, high = getEntryCount();
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (keyAt(mid) < key) low = mid + 1;
+        else high = mid;
+    }
+    
+    MoveList legal;
+    generateMoves(board, legal);
+    
+    int count = 0;
+    for (size_t i = low; i < getEntryCount() && keyAt(i) == key && count < maxMoves; i++) {
+        const unsigned char* entry = data + i * ENTRY_SIZE;
+        uint16_t encoded = uint16_t(readBigEndian(entry + 8, 2));
+        int weight = int(readBigEndian(entry + 10, 2));
+        
+        // A stale or foreign entry must never put an impossible move on the
+        // board, so book moves are matched against the generated ones.
+        for (int j = 0; j < legal.count; j++) {
+            if (encodeMove(legal.moves[j].move) == encoded) {
+                moves[count++] = BookMove{legal.moves[j].move, weight};
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+Move OpeningBook::pick(const Board& board, uint64_t random) const {
+    BookMove moves[MAX_MOVES];
+    int count = probe(board, moves, MAX_MOVES);
+    
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += moves[i].weight;
+    }
+    if (total == 0) return Move();
+    
+    uint64_t target = random % total;
+    for (int i = 0; i < count; i++) {
+        if (target < uint64_t(moves[i].weight)) return moves[i].move;
+        target -= moves[i].weight;
+    }
+    return Move();
+}
+
+uint16_t OpeningBook::encodeMove(Move move) {
+    int from = bookSquare(move.from());
+    int to = bookSquare(move.to());
+    // Castling is written as the king taking its own rook.
+    if (move.flag() == CASTLING) to = bookSquare((move.from() & ~7) | ((move.to() & 7) == 6 ? 7 : 0));
+    int promotion = 0;
+    if (move.flag() == PROMOTION) {
+        for (int i = 1; i < 5; i++) {
+            if (promotionPieces[i] == move.promotion()) promotion = i;
+        }
+    }
+    return uint16_t((to % 8) | (to / 8) << 3 | (from % 8) << 6 | (from / 8) << 9 | promotion << 12);
+}
+
+void OpeningBook::writeEntry(unsigned char* out, uint64_t key, Move move, uint16_t weight) {
+    writeBigEndian(out, key, 8);
+    writeBigEndian(out + 8, encodeMove(move), 2);
+    writeBigEndian(out + 10, weight, 2);
+    writeBigEndian(out + 12, 0, 4);
+}
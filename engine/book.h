@@ -0,0 +1,60 @@
+#ifndef CHESS_ENGINE_BOOK_H
+#define CHESS_ENGINE_BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "board.h"
+
+struct BookMove {
+    Move move;
+    int weight;
+};
+
+// Opening book in this engine's own format: 16-byte big-endian entries
+// (key, move, weight, learn) sorted by key, several entries per position,
+// keyed by Board::getKey(). The entry layout is Polyglot's, but the keys
+// are not, so Polyglot books from other programs find no positions here
+// and books from tools/makebook are of no use to them.
+//
+// The file is mapped read-only, so opening even a large book costs nothing
+// up front and processes using the same book share its pages. Lookups are
+// a binary search over the mapping.
+class OpeningBook {
+public:
+    OpeningBook();
+    ~OpeningBook();
+    
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+    
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    size_t getEntryCount() const { return length / ENTRY_SIZE; }
+    
+    // Book moves for the position that can be played in it, at most
+    // `maxMoves` of them, in file order.
+    int probe(const Board& board, BookMove* moves, int maxMoves) const;
+    
+    // A book move chosen with probability proportional to its weight, using
+    // `random` as the source of randomness; null if the position is not in
+    // the book.
+    Move pick(const Board& board, uint64_t random) const;
+    
+    static const size_t ENTRY_SIZE = 16;
+    
+    // Move field: to-file bits 0-2, to-rank 3-5, from-file 6-8, from-rank
+    // 9-11, promotion 12-14 (knight=1 ... queen=4).
+    static uint16_t encodeMove(Move move);
+    static void writeEntry(unsigned char* out, uint64_t key, Move move, uint16_t weight);
+
+private:
+    uint64_t keyAt(size_t index) const;
+    
+    const unsigned char* data;
+    size_t length;
+};
+
+#endif
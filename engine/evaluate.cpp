@@ -0,0 +1,189 @@
+#include "evaluate.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "psqt.h"
+
+namespace {
+
+// Middlegame and endgame halves of a term, blended by the phase at the end.
+struct Score {
+    int middlegame = 0;
+    int endgame = 0;
+    
+    void add(int mg, int eg) {
+        middlegame += mg;
+        endgame += eg;
+    }
+};
+
+const int DOUBLED_PAWN[2] = {-10, -20};
+const int ISOLATED_PAWN[2] = {-8, -12};
+// Indexed by how far the pawn has come from its starting rank.
+const int PASSED_PAWN[2][7] = {{0, 2, 5, 10, 20, 35, 0}, {0, 10, 15, 25, 45, 70, 0}};
+const int ROOK_OPEN_FILE[2] = {25, 10};
+const int ROOK_SEMI_OPEN_FILE[2] = {12, 6};
+// Per pawn in the three files in front of the king, one and two ranks up.
+const int KING_SHELTER = 8;
+
+// Per square a piece attacks that is neither its own side's nor covered by
+// an enemy pawn, counted from a typical number for the piece. The queen is
+// left out: her weight would be small, and her attacks cost two lookups.
+const int KNIGHT_MOBILITY[2] = {4, 4};
+const int BISHOP_MOBILITY[2] = {5, 5};
+const int ROOK_MOBILITY[2] = {2, 4};
+const int KNIGHT_SQUARES = 4;
+const int BISHOP_SQUARES = 6;
+const int ROOK_SQUARES = 6;
+
+constexpr Bitboard FILE_A = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H = FILE_A << 7;
+
+// Built at compile time like the attack tables.
+struct EvalMasks {
+    Bitboard file[8];
+    Bitboard adjacentFiles[8];
+    Bitboard passed[3][64];  // [color][square]: squares an enemy pawn could stop it from
+    Bitboard shelter[3][64];  // [color][king square]
+    
+    constexpr EvalMasks() : file(), adjacentFiles(), passed(), shelter() {
+        for (int col = 0; col < 8; col++) {
+            file[col] = FILE_A << col;
+            if (col > 0) adjacentFiles[col] |= FILE_A << (col - 1);
+            if (col < 7) adjacentFiles[col] |= FILE_A << (col + 1);
+        }
+        for (int square = 0; square < 64; square++) {
+            int row = square / 8;
+            int col = square % 8;
+            Bitboard span = file[col] | adjacentFiles[col];
+            for (int r = 0; r < 8; r++) {
+                Bitboard rank = Bitboard(0xFF) << (r * 8);
+                // White pawns advance towards row 0.
+                if (r < row) passed[WHITE][square] |= span & rank;
+                if (r > row) passed[BLACK][square] |= span & rank;
+                if (r == row - 1 || r == row - 2) shelter[WHITE][square] |= span & rank;
+                if (r == row + 1 || r == row + 2) shelter[BLACK][square] |= span & rank;
+            }
+        }
+    }
+};
+
+constexpr EvalMasks masks;
+
+Bitboard pawnAttacks(PieceColor color, Bitboard pawns) {
+    if (color == WHITE) return ((pawns >> 9) & ~FILE_H) | ((pawns >> 7) & ~FILE_A);
+    return ((pawns << 7) & ~FILE_H) | ((pawns << 9) & ~FILE_A);
+}
+
+// From `color`'s side; the caller subtracts Black's.
+Score pawnStructure(const BitboardPosition& bitboards, PieceColor color) {
+    Bitboard pawns = bitboards.pieces[color][PAWN];
+    Bitboard enemyPawns = bitboards.pieces[opponent(color)][PAWN];
+    Score score;
+    
+    for (int col = 0; col < 8; col++) {
+        int count = popCount(pawns & masks.file[col]);
+        if (count == 0) continue;
+        if (count > 1) score.add(DOUBLED_PAWN[0] * (count - 1), DOUBLED_PAWN[1] * (count - 1));
+        if (!(pawns & masks.adjacentFiles[col])) score.add(ISOLATED_PAWN[0] * count, ISOLATED_PAWN[1] * count);
+    }
+    
+    Bitboard remaining = pawns;
+    while (remaining) {
+        int square = popLSB(remaining);
+        if (enemyPawns & masks.passed[color][square]) continue;
+        // Pawns stand on rows 1-6; each starts two rows from its own edge.
+        int advanced = (color == WHITE) ? 6 - square / 8 : square / 8 - 1;
+        score.add(PASSED_PAWN[0][advanced], PASSED_PAWN[1][advanced]);
+    }
+    return score;
+}
+
+Score pawnStructure(const BitboardPosition& bitboards) {
+    Score white = pawnStructure(bitboards, WHITE);
+    Score black = pawnStructure(bitboards, BLACK);
+    white.add(-black.middlegame, -black.endgame);
+    return white;
+}
+
+// Mobility, rooks on open files and king shelter, from `color`'s side.
+Score pieces(const BitboardPosition& bitboards, PieceColor color) {
+    PieceColor enemy = opponent(color);
+    Bitboard ownPawns = bitboards.pieces[color][PAWN];
+    Bitboard allPawns = ownPawns | bitboards.pieces[enemy][PAWN];
+    Bitboard reachable = ~bitboards.colors[color] & ~pawnAttacks(enemy, bitboards.pieces[enemy][PAWN]);
+    Bitboard occupied = bitboards.occupied;
+    Score score;
+    
+    // Summed per piece type, then weighted once.
+    int knights = 0, bishops = 0, rooks = 0;
+    for (Bitboard b = bitboards.pieces[color][KNIGHT]; b;) {
+        knights += popCount(attackTables.knight[popLSB(b)] & reachable) - KNIGHT_SQUARES;
+    }
+    for (Bitboard b = bitboards.pieces[color][BISHOP]; b;) {
+        bishops += popCount(bishopAttacks(popLSB(b), occupied) & reachable) - BISHOP_SQUARES;
+    }
+    for (Bitboard b = bitboards.pieces[color][ROOK]; b;) {
+        int square = popLSB(b);
+        rooks += popCount(rookAttacks(square, occupied) & reachable) - ROOK_SQUARES;
+        Bitboard file = masks.file[square % 8];
+        if (!(file & allPawns)) score.add(ROOK_OPEN_FILE[0], ROOK_OPEN_FILE[1]);
+        else if (!(file & ownPawns)) score.add(ROOK_SEMI_OPEN_FILE[0], ROOK_SEMI_OPEN_FILE[1]);
+    }
+    score.add(KNIGHT_MOBILITY[0] * knights + BISHOP_MOBILITY[0] * bishops + ROOK_MOBILITY[0] * rooks,
+              KNIGHT_MOBILITY[1] * knights + BISHOP_MOBILITY[1] * bishops + ROOK_MOBILITY[1] * rooks);
+    
+    // Middlegame only: once the pieces are off the king belongs in the centre.
+    Bitboard king = bitboards.pieces[color][KING];
+    if (king) score.add(KING_SHELTER * popCount(ownPawns & masks.shelter[color][lsb(king)]), 0);
+    return score;
+}
+
+int taper(const Board& board, const Score& score) {
+    int phase = std::min(board.getPhase(), psqt::MAX_PHASE);
+    return (score.middlegame * phase + score.endgame * (psqt::MAX_PHASE - phase)) / psqt::MAX_PHASE;
+}
+
+// Skips the piece terms when the rest of the score is already more than
+// LAZY_EVAL_MARGIN outside [lower, upper]. They are held within that
+// margin, so they could not have brought it back, and the score returned
+// is the nearest they could reach: a true bound on the full score.
+int evaluate(const Board& board, const Score& pawns, int lower, int upper) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    Score score = pawns;
+    score.add(board.getMiddlegameScore(), board.getEndgameScore());
+    int lazy = taper(board, score);
+    if (lazy + LAZY_EVAL_MARGIN <= lower) return lazy + LAZY_EVAL_MARGIN;
+    if (lazy - LAZY_EVAL_MARGIN >= upper) return lazy - LAZY_EVAL_MARGIN;
+    
+    Score white = pieces(bitboards, WHITE);
+    Score black = pieces(bitboards, BLACK);
+    Score difference;
+    difference.add(white.middlegame - black.middlegame, white.endgame - black.endgame);
+    return lazy + std::max(-LAZY_EVAL_MARGIN, std::min(taper(board, difference), LAZY_EVAL_MARGIN));
+}
+
+}
+
+// A zero key with zero scores is right for the one skeleton it matches,
+// the position without pawns.
+PawnHashTable::PawnHashTable() : entries(new Entry[SIZE]()) {}
+
+// The board keeps the piece-square totals current on every move; the
+// other terms are worked out from the bitboards.
+int evaluateBoard(const Board& board) {
+    return evaluate(board, pawnStructure(board.getBitboards()), -INT_MAX, INT_MAX);
+}
+
+int evaluateBoard(const Board& board, PawnHashTable& pawnTable, int lower, int upper) {
+    uint64_t key = board.getPawnKey();
+    PawnHashTable::Entry& entry = pawnTable.slot(key);
+    if (!PawnHashTable::matches(entry, key)) {
+        Score pawns = pawnStructure(board.getBitboards());
+        entry = PawnHashTable::Entry{PawnHashTable::checkOf(key), int16_t(pawns.middlegame), int16_t(pawns.endgame)};
+    }
+    Score pawns;
+    pawns.add(entry.middlegame, entry.endgame);
+    return evaluate(board, pawns, lower, upper);
+}
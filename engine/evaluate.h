@@ -0,0 +1,61 @@
+#ifndef CHESS_ENGINE_EVALUATE_H
+#define CHESS_ENGINE_EVALUATE_H
+
+#include <cstdint>
+#include <memory>
+
+#include "board.h"
+
+// Piece values in centipawns, used for capture ordering. The king's value
+// only has to outrank everything else.
+constexpr int pieceValues[7] = {0, 100, 500, 320, 330, 900, 20000}; // EMPTY, PAWN, ROOK, KNIGHT, BISHOP, QUEEN, KING
+
+// Pawn-structure scores (doubled, isolated and passed pawns) by the board's
+// pawn key. Pawns move far less often than pieces, so most leaves of a
+// search share a skeleton that has already been scored. Not thread-safe:
+// each search thread has its own.
+class PawnHashTable {
+public:
+    // Eight bytes, so the whole table (64 KB) stays in the L2 cache. The
+    // index is taken from the low bits of the key and the check from the
+    // high ones.
+    struct Entry {
+        uint32_t check;
+        int16_t middlegame;  // from White's point of view
+        int16_t endgame;
+    };
+    
+    PawnHashTable();
+    
+    // Where `key` is stored; it holds that skeleton's scores only if
+    // matches() says so.
+    Entry& slot(uint64_t key) { return entries[key & (SIZE - 1)]; }
+    static bool matches(const Entry& entry, uint64_t key) { return entry.check == uint32_t(key >> 32); }
+    static uint32_t checkOf(uint64_t key) { return uint32_t(key >> 32); }
+
+private:
+    static const size_t SIZE = 1 << 13;
+    
+    std::unique_ptr<Entry[]> entries;
+};
+
+// The most the piece terms (mobility, rooks on open files, king shelter)
+// of both sides together may move the score either way; beyond it they
+// are cut off. So a position whose other terms are further than this
+// outside the window cannot come back inside it, and its piece terms can
+// be skipped. They stayed within 75 over the bench positions' searches, so
+// the cap very rarely applies.
+const int LAZY_EVAL_MARGIN = 100;
+
+// Static score in centipawns from White's point of view.
+int evaluateBoard(const Board& board);
+
+// The same score, with the pawn structure looked up in `pawnTable` first.
+// The caller only needs it within [lower, upper] (White's point of view): a
+// position more than LAZY_EVAL_MARGIN outside that skips the piece terms
+// and gets the nearest score they could have given it, which is a bound
+// on the full score on the same side of the window but depends on the
+// window asked for.
+int evaluateBoard(const Board& board, PawnHashTable& pawnTable, int lower, int upper);
+
+#endif
@@ -0,0 +1,364 @@
+#include "game_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <sstream>
+
+#include "movegen.h"
+#include "notation.h"
+
+namespace {
+
+// Empty while the game goes on.
+std::string gameStatus(const Board& board) {
+    MoveList legal;
+    generateMoves(board, legal);
+    if (legal.empty()) return isInCheck(board) ? "mate" : "stalemate";
+    if (board.getHalfmoveClock() >= 100) return "fifty";
+    
+    // Only positions since the last capture or pawn move can repeat.
+    const std::vector<MoveRecord>& history = board.getMoveHistory();
+    int repeats = 0;
+    for (size_t back = 1; back <= history.size() && int(back) <= board.getHalfmoveClock(); back++) {
+        if (history[history.size() - back].key == board.getKey()) repeats++;
+    }
+    return (repeats >= 2) ? "repetition" : "";
+}
+
+std::string withStatus(std::string line, const Board& board) {
+    std::string status = gameStatus(board);
+    if (!status.empty()) line += " " + status;
+    return line;
+}
+
+}
+
+void LatencyHistogram::clear() {
+    std::fill(buckets, buckets + BUCKETS, 0);
+    count = 0;
+    max = 0;
+}
+
+// Values below SUB_BUCKETS have a bucket each; above, every power of two
+// is split into SUB_BUCKETS equal parts.
+int LatencyHistogram::bucketOf(uint64_t microseconds) {
+    if (microseconds < uint64_t(SUB_BUCKETS)) return int(microseconds);
+    int high = 0;
+    for (uint64_t value = microseconds; value > 1; value >>= 1) high++;
+    int shift = high - 4;
+    return (high - 3) * SUB_BUCKETS + int((microseconds >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::bucketTop(int bucket) {
+    if (bucket < SUB_BUCKETS) return uint64_t(bucket);
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t low = uint64_t(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t microseconds) {
+    buckets[bucketOf(microseconds)]++;
+    count++;
+    max = std::max(max, microseconds);
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKETS; i++) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    max = std::max(max, other.max);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (count == 0) return 0;
+    uint64_t target = std::max<uint64_t>(1, uint64_t(std::ceil(fraction * count)));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) return std::min(bucketTop(i), max);
+    }
+    return max;
+}
+
+GameServer::GameServer(const ServerConfig& serverConfig, ReplyCallback replyCallback)
+    : config(serverConfig), reply(std::move(replyCallback)),
+      table(std::make_shared<TranspositionTable>(serverConfig.hashMegabytes)), nextSession(1), queued(0), running(0),
+      completed(0), rejected(0), late(0), statsStart(Clock::now()), stopping(false) {
+    for (int i = 0; i < std::max(1, config.workers); i++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+GameServer::~GameServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void GameServer::handle(int client, const std::string& line) {
+    std::istringstream in(line);
+    std::string command;
+    if (!(in >> command)) return;
+    
+    if (command == "new") {
+        newSession(client, in);
+    } else if (command == "move") {
+        playMove(client, in);
+    } else if (command == "go") {
+        queueSearch(client, in);
+    } else if (command == "fen" || command == "close") {
+        uint64_t id = 0;
+        in >> id;
+        std::string answer;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Session* session = findSession(client, id);
+            if (!session) return;
+            if (command == "fen") {
+                answer = "fen " + std::to_string(id) + " " + session->board.toFEN();
+            } else {
+                // A queued request for it is dropped when a worker takes it.
+                sessions.erase(id);
+                answer = "closed " + std::to_string(id);
+            }
+        }
+        reply(client, answer);
+    } else if (command == "stats") {
+        sendStats(client);
+    } else if (command == "reset") {
+        resetStats();
+        reply(client, "reset");
+    } else {
+        reply(client, "error unknown command " + command);
+    }
+}
+
+GameServer::Session* GameServer::findSession(int client, uint64_t id) {
+    auto found = sessions.find(id);
+    if (found == sessions.end() || found->second.client != client) {
+        reply(client, "error " + std::to_string(id) + " unknown session");
+        return nullptr;
+    }
+    return &found->second;
+}
+
+void GameServer::newSession(int client, std::istringstream& in) {
+    std::string fen;
+    std::getline(in >> std::ws, fen);
+    
+    Session session;
+    session.client = client;
+    session.busy = false;
+    if (fen.empty()) {
+        session.board.initializeBoard();
+    } else if (!session.board.loadFEN(fen)) {
+        reply(client, "error invalid fen " + fen);
+        return;
+    }
+    
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sessions.size() >= config.maxSessions) {
+            reply(client, "error session limit");
+            return;
+        }
+        id = nextSession++;
+        sessions.emplace(id, std::move(session));
+    }
+    reply(client, "new " + std::to_string(id));
+}
+
+void GameServer::playMove(int client, std::istringstream& in) {
+    uint64_t id = 0;
+    std::string text;
+    in >> id >> text;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    Session* session = findSession(client, id);
+    if (!session) return;
+    if (session->busy) {
+        reply(client, "error " + std::to_string(id) + " thinking");
+        return;
+    }
+    Move move = parseMove(session->board, text);
+    if (move.isNull()) {
+        reply(client, "error " + std::to_string(id) + " illegal move " + text);
+        return;
+    }
+    session->board.makeMove(move);
+    reply(client, withStatus("moved " + std::to_string(id) + " " + moveToString(move), session->board));
+}
+
+void GameServer::queueSearch(int client, std::istringstream& in) {
+    Clock::time_point received = Clock::now();
+    uint64_t id = 0;
+    int budgetMs = 0;
+    in >> id;
+    if (!(in >> budgetMs) || budgetMs <= 0) budgetMs = config.defaultBudgetMs;
+    budgetMs = std::min(budgetMs, config.maxBudgetMs);
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Session* session = findSession(client, id);
+        if (!session) return;
+        if (session->busy) {
+            reply(client, "error " + std::to_string(id) + " thinking");
+            return;
+        }
+        MoveList legal;
+        generateMoves(session->board, legal);
+        if (legal.empty()) {
+            reply(client, "error " + std::to_string(id) + " game over");
+            return;
+        }
+        
+        std::deque<Request>& queue = queues[client];
+        if (queued >= config.maxQueued || queue.size() >= config.maxQueuedPerClient) {
+            if (queue.empty()) queues.erase(client);
+            rejected++;
+            reply(client, "busy " + std::to_string(id));
+            return;
+        }
+        if (queue.empty()) readyClients.push_back(client);
+        queue.push_back(Request{id, received, received + std::chrono::milliseconds(budgetMs)});
+        queued++;
+        session->busy = true;
+    }
+    wake.notify_one();
+}
+
+void GameServer::dropClient(int client) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        it = (it->second.client == client) ? sessions.erase(it) : std::next(it);
+    }
+    auto queue = queues.find(client);
+    if (queue != queues.end()) {
+        queued -= queue->second.size();
+        queues.erase(queue);
+        readyClients.erase(std::remove(readyClients.begin(), readyClients.end(), client), readyClients.end());
+    }
+}
+
+bool GameServer::isIdle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queued == 0 && running == 0;
+}
+
+ServerStats GameServer::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ServerStats stats;
+    stats.sessions = sessions.size();
+    stats.queued = queued;
+    stats.running = running;
+    stats.completed = completed;
+    stats.rejected = rejected;
+    stats.late = late;
+    stats.seconds = std::chrono::duration<double>(Clock::now() - statsStart).count();
+    stats.latency = latency;
+    return stats;
+}
+
+void GameServer::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    completed = rejected = late = 0;
+    latency.clear();
+    statsStart = Clock::now();
+}
+
+void GameServer::sendStats(int client) {
+    ServerStats stats = getStats();
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer),
+                  "stats sessions %zu queued %zu running %d completed %llu rejected %llu late %llu rps %.1f "
+                  "p50 %.1f p99 %.1f max %.1f",
+                  stats.sessions, stats.queued, stats.running, (unsigned long long)stats.completed,
+                  (unsigned long long)stats.rejected, (unsigned long long)stats.late, stats.requestsPerSecond(),
+                  stats.latency.percentile(0.5) / 1000.0, stats.latency.percentile(0.99) / 1000.0,
+                  stats.latency.getMax() / 1000.0);
+    reply(client, buffer);
+}
+
+// Each worker has its own Search (board copy and move stacks) over the one
+// shared table, as the helper threads of a single search do.
+void GameServer::workerLoop() {
+    std::unique_ptr<Search> search(new Search(table));
+    search->setStopFlag(&stopping);
+    
+    Request request;
+    int client;
+    while (takeRequest(request, client)) {
+        Move move;
+        bool wasLate = false;
+        if (prepareSearch(request, *search)) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(request.deadline - Clock::now());
+            wasLate = remaining.count() <= 0;
+            SearchLimits limits;
+            limits.timeMs = std::max(1, int(remaining.count()));
+            move = search->getBestMove(limits);
+        }
+        finishSearch(request, client, move, wasLate);
+    }
+}
+
+bool GameServer::takeRequest(Request& request, int& client) {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this]() { return stopping.load() || !readyClients.empty(); });
+    if (stopping.load()) return false;
+    
+    client = readyClients.front();
+    readyClients.pop_front();
+    std::deque<Request>& queue = queues[client];
+    request = queue.front();
+    queue.pop_front();
+    queued--;
+    if (queue.empty()) {
+        queues.erase(client);
+    } else {
+        readyClients.push_back(client);
+    }
+    running++;
+    return true;
+}
+
+bool GameServer::prepareSearch(const Request& request, Search& search) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto session = sessions.find(request.session);
+    if (session == sessions.end()) return false;
+    search.setPosition(session->second.board);
+    return true;
+}
+
+void GameServer::finishSearch(const Request& request, int client, Move move, bool wasLate) {
+    Clock::time_point now = Clock::now();
+    // The answer goes out before the lock is released, so once isIdle()
+    // holds every answer has been handed over.
+    std::lock_guard<std::mutex> lock(mutex);
+    running--;
+    auto found = sessions.find(request.session);
+    if (found == sessions.end()) return;
+    Session& session = found->second;
+    session.busy = false;
+    if (move.isNull() || stopping.load()) return;
+    
+    session.board.makeMove(move);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - request.received);
+    uint64_t microseconds = uint64_t(elapsed.count());
+    latency.record(microseconds);
+    completed++;
+    late += wasLate;
+    
+    char milliseconds[32];
+    std::snprintf(milliseconds, sizeof(milliseconds), " %.1f", microseconds / 1000.0);
+    reply(client, withStatus("bestmove " + std::to_string(request.session) + " " + moveToString(move) + milliseconds,
+                             session.board));
+}
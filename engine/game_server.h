@@ -0,0 +1,184 @@
+#ifndef CHESS_ENGINE_GAME_SERVER_H
+#define CHESS_ENGINE_GAME_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "board.h"
+#include "search.h"
+#include "transposition.h"
+
+// Request latencies in microseconds, counted into buckets 1/16 of a power
+// of two wide, so percentiles are exact to about 4% in any range and the
+// memory stays fixed however many requests are recorded.
+class LatencyHistogram {
+public:
+    LatencyHistogram() { clear(); }
+    
+    void clear();
+    void record(uint64_t microseconds);
+    void add(const LatencyHistogram& other);
+    
+    uint64_t getCount() const { return count; }
+    // Upper end of the bucket holding the `fraction` quantile, e.g. 0.99.
+    uint64_t percentile(double fraction) const;
+    uint64_t getMax() const { return max; }
+
+private:
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKETS = 64 * SUB_BUCKETS;
+    
+    static int bucketOf(uint64_t microseconds);
+    static uint64_t bucketTop(int bucket);
+    
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t max;
+};
+
+struct ServerConfig {
+    int workers;               // search threads
+    size_t hashMegabytes;      // one table shared by all workers
+    size_t maxSessions;
+    size_t maxQueued;          // AI requests waiting, over all clients
+    size_t maxQueuedPerClient;
+    int defaultBudgetMs;       // for `go` without a budget
+    int maxBudgetMs;
+    
+    ServerConfig()
+        : workers(1), hashMegabytes(64), maxSessions(100000), maxQueued(4096), maxQueuedPerClient(256),
+          defaultBudgetMs(100), maxBudgetMs(10000) {}
+};
+
+// Totals since the server started or since resetStats().
+struct ServerStats {
+    size_t sessions;
+    size_t queued;
+    int running;
+    uint64_t completed;
+    uint64_t rejected;  // answered `busy`
+    uint64_t late;      // started after their budget had run out
+    double seconds;
+    LatencyHistogram latency;
+    
+    double requestsPerSecond() const { return seconds > 0 ? completed / seconds : 0.0; }
+};
+
+// Keeps many games in memory and plays AI moves in them on a fixed pool of
+// worker threads, for clients talking a line protocol:
+//
+//   new [FEN]            new ID
+//   move ID MOVE         moved ID MOVE [STATUS]   (SAN or coordinates)
+//   go ID [MS]           bestmove ID MOVE MS [STATUS], once searched
+//   fen ID               fen ID FEN
+//   close ID             closed ID
+//   stats                stats sessions N queued N ... p50 MS p99 MS
+//   reset                reset (clears the counters of `stats`)
+//
+// `go` plays the engine's move for the side to move. Its budget (the
+// server's default if not given, at most the configured maximum) covers
+// the whole request: time spent queued is taken off the search, so a
+// request is answered about when its budget runs out even under load. The
+// reply gives the milliseconds it took from receipt. STATUS is mate,
+// stalemate, fifty or repetition once the game is over.
+//
+// Sessions belong to the client that created them and go when it does.
+// Queued requests are served round-robin between clients, so one client
+// cannot starve the others however much it sends, and a session has at
+// most one request in flight. A request that would overfill the queue, in
+// total or for its client, is answered `busy ID` straight away and can be
+// sent again later. Errors come back as `error [ID] REASON`.
+//
+// handle() and dropClient() are called from one I/O thread. Replies are
+// passed to the callback given at construction, from that thread for most
+// commands and from a worker for `go`, sometimes with the server's lock
+// held, so the callback must not call back into the server.
+class GameServer {
+public:
+    typedef std::function<void(int client, const std::string& line)> ReplyCallback;
+    
+    GameServer(const ServerConfig& config, ReplyCallback reply);
+    // Stops the searches still running and joins the workers.
+    ~GameServer();
+    
+    GameServer(const GameServer&) = delete;
+    GameServer& operator=(const GameServer&) = delete;
+    
+    void handle(int client, const std::string& line);
+    
+    // Closes the client's sessions and drops its queued requests; a search
+    // already running for it finishes without a reply.
+    void dropClient(int client);
+    
+    // No request queued or being searched.
+    bool isIdle() const;
+    
+    ServerStats getStats() const;
+    void resetStats();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct Session {
+        Board board;
+        int client;
+        bool busy;  // a `go` is queued or running
+    };
+    
+    struct Request {
+        uint64_t session;
+        Clock::time_point received;
+        Clock::time_point deadline;
+    };
+    
+    void newSession(int client, std::istringstream& in);
+    void playMove(int client, std::istringstream& in);
+    void queueSearch(int client, std::istringstream& in);
+    void sendStats(int client);
+    
+    // Finds the session for a command, or replies with an error.
+    Session* findSession(int client, uint64_t id);
+    
+    void workerLoop();
+    // Takes the next request round-robin; false once the server stops.
+    bool takeRequest(Request& request, int& client);
+    // Sets `search` to the request's position; false if the session was
+    // closed while the request waited.
+    bool prepareSearch(const Request& request, Search& search);
+    // Plays the move into the session and answers the request.
+    void finishSearch(const Request& request, int client, Move move, bool wasLate);
+    
+    ServerConfig config;
+    ReplyCallback reply;
+    std::shared_ptr<TranspositionTable> table;
+    
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<uint64_t, Session> sessions;
+    uint64_t nextSession;
+    std::map<int, std::deque<Request>> queues;  // by client
+    std::deque<int> readyClients;  // clients with queued requests, in turn order
+    size_t queued;
+    int running;
+    uint64_t completed, rejected, late;
+    LatencyHistogram latency;
+    Clock::time_point statsStart;
+    
+    std::atomic<bool> stopping;
+    std::vector<std::thread> workers;
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include "movegen.h"
+
+Bitboard pieceTargets(const Board& board, int square) {
+    const Piece& piece = board.pieceAt(square);
+    if (piece.type == EMPTY) return 0;
+    
+    const BitboardPosition& bitboards = board.getBitboards();
+    Bitboard occupied = bitboards.occupied;
+    Bitboard targets = 0;
+    
+    switch (piece.type) {
+        case PAWN: {
+            int forward = (piece.color == WHITE) ? -8 : 8;
+            int startRow = (piece.color == WHITE) ? 6 : 1;
+            int oneStep = square + forward;
+            
+            if (oneStep >= 0 && oneStep < 64 && !(occupied & squareBB(oneStep))) {
+                targets |= squareBB(oneStep);
+                if (square / 8 == startRow && !(occupied & squareBB(oneStep + forward))) {
+                    targets |= squareBB(oneStep + forward);
+                }
+            }
+            return targets | (attackTables.pawn[piece.color][square] & bitboards.colors[opponent(piece.color)]);
+        }
+        
+        case ROOK:
+            targets = rookAttacks(square, occupied);
+            break;
+            
+        case BISHOP:
+            targets = bishopAttacks(square, occupied);
+            break;
+            
+        case QUEEN:
+            targets = rookAttacks(square, occupied) | bishopAttacks(square, occupied);
+            break;
+            
+        case KING:
+            targets = attackTables.king[square];
+            break;
+            
+        case KNIGHT:
+            targets = attackTables.knight[square];
+            break;
+            
+        default:
+            return 0;
+    }
+    
+    return targets & ~bitboards.colors[piece.color];
+}
+
+Bitboard attackersTo(const Board& board, int square, Bitboard occupied) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    Bitboard rooks = bitboards.pieces[WHITE][ROOK] | bitboards.pieces[BLACK][ROOK] |
+                     bitboards.pieces[WHITE][QUEEN] | bitboards.pieces[BLACK][QUEEN];
+    Bitboard bishops = bitboards.pieces[WHITE][BISHOP] | bitboards.pieces[BLACK][BISHOP] |
+                       bitboards.pieces[WHITE][QUEEN] | bitboards.pieces[BLACK][QUEEN];
+    
+    // A white pawn attacks `square` from where a black pawn on `square`
+    // would capture, and the other way round.
+    Bitboard attackers = (attackTables.pawn[BLACK][square] & bitboards.pieces[WHITE][PAWN]) |
+                         (attackTables.pawn[WHITE][square] & bitboards.pieces[BLACK][PAWN]) |
+                         (attackTables.knight[square] &
+                          (bitboards.pieces[WHITE][KNIGHT] | bitboards.pieces[BLACK][KNIGHT])) |
+                         (attackTables.king[square] &
+                          (bitboards.pieces[WHITE][KING] | bitboards.pieces[BLACK][KING])) |
+                         (rookAttacks(square, occupied) & rooks) |
+                         (bishopAttacks(square, occupied) & bishops);
+    return attackers & occupied;
+}
+
+Bitboard getCheckers(const Board& board) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    PieceColor us = board.getCurrentPlayer();
+    int king = lsb(bitboards.pieces[us][KING]);
+    return attackersTo(board, king, bitboards.occupied) & bitboards.colors[opponent(us)];
+}
+
+namespace {
+
+enum GenType {
+    GEN_CAPTURES,  // captures, en passant and promotions
+    GEN_QUIETS,    // everything else, castling included
+    GEN_ALL
+};
+
+const PieceType promotionOrder[4] = {QUEEN, KNIGHT, ROOK, BISHOP};
+
+// True if nothing of `them` attacks `king` once the board holds `occupied`
+// and the pieces in `removed` have been taken.
+bool kingSafe(const Board& board, PieceColor us, int king, Bitboard occupied, Bitboard removed) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    PieceColor them = opponent(us);
+    const Bitboard* theirs = bitboards.pieces[them];
+    Bitboard queens = theirs[QUEEN];
+    Bitboard attackers = (rookAttacks(king, occupied) & (theirs[ROOK] | queens)) |
+                         (bishopAttacks(king, occupied) & (theirs[BISHOP] | queens)) |
+                         (attackTables.knight[king] & theirs[KNIGHT]) |
+                         (attackTables.pawn[us][king] & theirs[PAWN]) |
+                         (attackTables.king[king] & theirs[KING]);
+    return (attackers & ~removed) == 0;
+}
+
+// Our pieces that are the only thing between our king and an enemy slider.
+Bitboard pinnedPieces(const Board& board, PieceColor us, int king) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    const Bitboard* theirs = bitboards.pieces[opponent(us)];
+    Bitboard snipers = (rookAttacks(king, 0) & (theirs[ROOK] | theirs[QUEEN])) |
+                       (bishopAttacks(king, 0) & (theirs[BISHOP] | theirs[QUEEN]));
+    Bitboard pinned = 0;
+    while (snipers) {
+        Bitboard blockers = attackTables.between[king][popLSB(snipers)] & bitboards.occupied;
+        if (blockers && !(blockers & (blockers - 1))) pinned |= blockers & bitboards.colors[us];
+    }
+    return pinned;
+}
+
+void addPromotions(int from, int to, MoveList& moves) {
+    for (PieceType piece : promotionOrder) {
+        moves.add(Move(from, to, PROMOTION, piece));
+    }
+}
+
+// `allowed` holds the squares that resolve a check and keep a pin.
+void addPawnMoves(const Board& board, int from, GenType type, Bitboard allowed, MoveList& moves) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    PieceColor us = board.getCurrentPlayer();
+    int forward = (us == WHITE) ? -8 : 8;
+    int startRow = (us == WHITE) ? 6 : 1;
+    int lastRow = (us == WHITE) ? 0 : 7;
+    int push = from + forward;
+    
+    if (!(bitboards.occupied & squareBB(push))) {
+        if (push / 8 == lastRow) {
+            if (type != GEN_QUIETS && (allowed & squareBB(push))) addPromotions(from, push, moves);
+        } else if (type != GEN_CAPTURES) {
+            if (allowed & squareBB(push)) moves.add(Move(from, push));
+            int doublePush = push + forward;
+            if (from / 8 == startRow && !(bitboards.occupied & squareBB(doublePush)) &&
+                (allowed & squareBB(doublePush))) {
+                moves.add(Move(from, doublePush));
+            }
+        }
+    }
+    if (type == GEN_QUIETS) return;
+    
+    Bitboard captures = attackTables.pawn[us][from] & bitboards.colors[opponent(us)] & allowed;
+    while (captures) {
+        int to = popLSB(captures);
+        if (to / 8 == lastRow) addPromotions(from, to, moves);
+        else moves.add(Move(from, to));
+    }
+    
+    // En passant removes two pawns from one rank, which can uncover a check
+    // no pin mask describes, so it gets the full test.
+    int ep = board.getEnPassantSquare();
+    if (ep >= 0 && (attackTables.pawn[us][from] & squareBB(ep))) {
+        int captured = (from & ~7) | (ep & 7);
+        Bitboard occupied = (bitboards.occupied ^ squareBB(from) ^ squareBB(captured)) | squareBB(ep);
+        int king = lsb(bitboards.pieces[us][KING]);
+        if (kingSafe(board, us, king, occupied, squareBB(captured))) {
+            moves.add(Move(from, ep, EN_PASSANT));
+        }
+    }
+}
+
+bool squareAttacked(const Board& board, int square, PieceColor by) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    return (attackersTo(board, square, bitboards.occupied) & bitboards.colors[by]) != 0;
+}
+
+// Only called when the king is not in check.
+void addCastling(const Board& board, MoveList& moves) {
+    PieceColor us = board.getCurrentPlayer();
+    PieceColor them = opponent(us);
+    int rights = board.getCastlingRights() & (us == WHITE ? WHITE_KINGSIDE | WHITE_QUEENSIDE
+                                                          : BLACK_KINGSIDE | BLACK_QUEENSIDE);
+    if (!rights) return;
+    
+    Bitboard occupied = board.getBitboards().occupied;
+    int king = (us == WHITE) ? 60 : 4;
+    if (rights & (WHITE_KINGSIDE | BLACK_KINGSIDE)) {
+        if (!(occupied & (squareBB(king + 1) | squareBB(king + 2))) && !squareAttacked(board, king + 1, them) &&
+            !squareAttacked(board, king + 2, them)) {
+            moves.add(Move(king, king + 2, CASTLING));
+        }
+    }
+    if (rights & (WHITE_QUEENSIDE | BLACK_QUEENSIDE)) {
+        if (!(occupied & (squareBB(king - 1) | squareBB(king - 2) | squareBB(king - 3))) &&
+            !squareAttacked(board, king - 1, them) && !squareAttacked(board, king - 2, them)) {
+            moves.add(Move(king, king - 2, CASTLING));
+        }
+    }
+}
+
+void generate(const Board& board, GenType type, MoveList& moves) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    PieceColor us = board.getCurrentPlayer();
+    PieceColor them = opponent(us);
+    Bitboard ours = bitboards.colors[us];
+    Bitboard occupied = bitboards.occupied;
+    int king = lsb(bitboards.pieces[us][KING]);
+    
+    Bitboard targetMask = ~ours;
+    if (type == GEN_CAPTURES) targetMask = bitboards.colors[them];
+    if (type == GEN_QUIETS) targetMask = ~occupied;
+    
+    Bitboard checkers = attackersTo(board, king, occupied) & bitboards.colors[them];
+    
+    // The king may not step onto an attacked square, including one that is
+    // only safe while the king itself blocks the attacking ray.
+    Bitboard kingTargets = attackTables.king[king] & targetMask;
+    Bitboard withoutKing = occupied ^ squareBB(king);
+    while (kingTargets) {
+        int to = popLSB(kingTargets);
+        if (!(attackersTo(board, to, withoutKing) & bitboards.colors[them])) moves.add(Move(king, to));
+    }
+    
+    // In double check only the king can move.
+    if (checkers & (checkers - 1)) return;
+    
+    // Other pieces must capture the checker or block its ray, and a pinned
+    // piece must stay on the line between its king and the pinner.
+    Bitboard checkMask = checkers ? attackTables.between[king][lsb(checkers)] | checkers : ~Bitboard(0);
+    Bitboard pinned = pinnedPieces(board, us, king);
+    
+    Bitboard pieces = ours & ~bitboards.pieces[us][KING];
+    while (pieces) {
+        int from = popLSB(pieces);
+        Bitboard allowed = checkMask;
+        if (pinned & squareBB(from)) allowed &= attackTables.line[king][from];
+        
+        PieceType piece = board.pieceAt(from).type;
+        if (piece == PAWN) {
+            addPawnMoves(board, from, type, allowed, moves);
+            continue;
+        }
+        
+        Bitboard targets = 0;
+        switch (piece) {
+            case KNIGHT: targets = attackTables.knight[from]; break;
+            case BISHOP: targets = bishopAttacks(from, occupied); break;
+            case ROOK: targets = rookAttacks(from, occupied); break;
+            case QUEEN: targets = rookAttacks(from, occupied) | bishopAttacks(from, occupied); break;
+            default: break;
+        }
+        targets &= targetMask & allowed;
+        while (targets) {
+            moves.add(Move(from, popLSB(targets)));
+        }
+    }
+    
+    if (type != GEN_CAPTURES && !checkers) addCastling(board, moves);
+}
+
+}
+
+void generateMoves(const Board& board, MoveList& moves) {
+    generate(board, GEN_ALL, moves);
+}
+
+void generateCaptures(const Board& board, MoveList& moves) {
+    generate(board, GEN_CAPTURES, moves);
+}
+
+void generateQuiets(const Board& board, MoveList& moves) {
+    generate(board, GEN_QUIETS, moves);
+}
+
+std::vector<Move> getAllValidMoves(const Board& board) {
+    MoveList list;
+    generateMoves(board, list);
+    
+    std::vector<Move> moves;
+    moves.reserve(list.count);
+    for (int i = 0; i < list.count; i++) {
+        moves.push_back(list.moves[i].move);
+    }
+    return moves;
+}
+
+bool isLegalMove(const Board& board, Move move) {
+    if (move.isNull()) return false;
+    
+    const BitboardPosition& bitboards = board.getBitboards();
+    PieceColor us = board.getCurrentPlayer();
+    int from = move.from();
+    int to = move.to();
+    const Piece& piece = board.pieceAt(from);
+    if (piece.type == EMPTY || piece.color != us) return false;
+    
+    if (move.flag() == CASTLING) {
+        if (piece.type != KING || isInCheck(board)) return false;
+        MoveList castles;
+        addCastling(board, castles);
+        for (int i = 0; i < castles.count; i++) {
+            if (castles.moves[i].move == move) return true;
+        }
+        return false;
+    }
+    
+    int lastRow = (us == WHITE) ? 0 : 7;
+    bool promotes = piece.type == PAWN && to / 8 == lastRow;
+    if (promotes != (move.flag() == PROMOTION)) return false;
+    
+    Bitboard removed = squareBB(to);
+    Bitboard occupied = (bitboards.occupied ^ squareBB(from)) | squareBB(to);
+    if (move.flag() == EN_PASSANT) {
+        if (piece.type != PAWN || to != board.getEnPassantSquare() ||
+            !(attackTables.pawn[us][from] & squareBB(to))) {
+            return false;
+        }
+        removed = squareBB((from & ~7) | (to & 7));
+        occupied ^= removed;
+    } else if (!(pieceTargets(board, from) & squareBB(to))) {
+        return false;
+    }
+    
+    int king = (piece.type == KING) ? to : lsb(bitboards.pieces[us][KING]);
+    return kingSafe(board, us, king, occupied, removed);
+}
+
+Move findMove(const Board& board, int from, int to) {
+    MoveList moves;
+    generateMoves(board, moves);
+    for (int i = 0; i < moves.count; i++) {
+        Move move = moves.moves[i].move;
+        // Queen promotions are generated first.
+        if (move.from() == from && move.to() == to) return move;
+    }
+    return Move();
+}
+
+bool isValidMove(const Board& board, int fromRow, int fromCol, int toRow, int toCol) {
+    if (toRow < 0 || toRow >= 8 || toCol < 0 || toCol >= 8) return false;
+    
+    return !findMove(board, squareOf(fromRow, fromCol), squareOf(toRow, toCol)).isNull();
+}
+
+std::string moveToString(Move move) {
+    if (move.isNull()) return "0000";
+    
+    std::string text;
+    text += char('a' + move.from() % 8);
+    text += char('8' - move.from() / 8);
+    text += char('a' + move.to() % 8);
+    text += char('8' - move.to() / 8);
+    if (move.flag() == PROMOTION) {
+        text += "  rnbq"[move.promotion()];
+    }
+    return text;
+}
+
+uint64_t perft(Board& board, int depth) {
+    if (depth == 0) return 1;
+    
+    MoveList moves;
+    generateMoves(board, moves);
+    if (depth == 1) return moves.count;
+    
+    uint64_t nodes = 0;
+    MoveRecord record;
+    for (int i = 0; i < moves.count; i++) {
+        board.makeTemporaryMove(moves.moves[i].move, record);
+        nodes += perft(board, depth - 1);
+        board.undoTemporaryMove(record);
+    }
+    return nodes;
+}
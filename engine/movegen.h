@@ -0,0 +1,73 @@
+#ifndef CHESS_ENGINE_MOVEGEN_H
+#define CHESS_ENGINE_MOVEGEN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+// No chess position has more moves than this.
+const int MAX_MOVES = 256;
+
+struct ScoredMove {
+    Move move;
+    int score;  // ordering score, higher is tried first
+};
+
+// Fixed-capacity move list, so generating moves never allocates.
+struct MoveList {
+    ScoredMove moves[MAX_MOVES];
+    int count;
+    
+    MoveList() : count(0) {}
+    
+    void add(Move move) {
+        moves[count].move = move;
+        moves[count].score = 0;
+        count++;
+    }
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+};
+
+// Squares the piece on `square` can move to: empty squares it reaches
+// and enemy pieces it attacks. Ignores checks, castling and en passant.
+Bitboard pieceTargets(const Board& board, int square);
+
+// Pieces of either color that attack `square`, treating only the pieces in
+// `occupied` as present so callers can look through removed pieces.
+Bitboard attackersTo(const Board& board, int square, Bitboard occupied);
+
+// Enemy pieces giving check to the side to move.
+Bitboard getCheckers(const Board& board);
+inline bool isInCheck(const Board& board) { return getCheckers(board) != 0; }
+
+// Legal moves for the side to move, including castling, en passant and
+// all four promotions. Checkers and pinned pieces are worked out once per
+// call, so no move has to be tried on the board to test it.
+void generateMoves(const Board& board, MoveList& moves);
+std::vector<Move> getAllValidMoves(const Board& board);
+
+// The two halves of generateMoves, for searches that want captures first
+// and may never need the quiet moves. Promotions count as captures here.
+void generateCaptures(const Board& board, MoveList& moves);
+void generateQuiets(const Board& board, MoveList& moves);
+
+// Whether `move` is legal for the side to move; for moves that may come
+// from another position, such as hash and killer moves.
+bool isLegalMove(const Board& board, Move move);
+
+// The legal move between two squares, preferring a queen promotion; null
+// if there is none.
+Move findMove(const Board& board, int from, int to);
+
+bool isValidMove(const Board& board, int fromRow, int fromCol, int toRow, int toCol);
+
+// Coordinate notation, e.g. "e2e4", "e1g1" for castling and "e7e8q".
+std::string moveToString(Move move);
+
+// Number of leaf nodes `depth` plies below the current position.
+uint64_t perft(Board& board, int depth);
+
+#endif
@@ -0,0 +1,166 @@
+#include "moveorder.h"
+
+#include <utility>
+
+#include "evaluate.h"
+#include "movegen.h"
+#include "see.h"
+
+void OrderingTables::clear() {
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        killers[ply][0] = Move();
+        killers[ply][1] = Move();
+    }
+    for (int c = 0; c < 3; c++) {
+        for (int from = 0; from < 64; from++) {
+            for (int to = 0; to < 64; to++) {
+                history[c][from][to] = 0;
+            }
+        }
+    }
+}
+
+void OrderingTables::age() {
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        killers[ply][0] = Move();
+        killers[ply][1] = Move();
+    }
+    for (int c = 0; c < 3; c++) {
+        for (int from = 0; from < 64; from++) {
+            for (int to = 0; to < 64; to++) {
+                history[c][from][to] /= 2;
+            }
+        }
+    }
+}
+
+void OrderingTables::recordCutoff(PieceColor color, Move move, int ply, int depth) {
+    if (ply < MAX_PLY && killers[ply][0] != move) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = move;
+    }
+    
+    int& score = history[color][move.from()][move.to()];
+    score += depth * depth;
+    // Keep scores well inside int range however long the game runs.
+    if (score > (1 << 20)) {
+        age();
+    }
+}
+
+MovePicker::MovePicker(const Board& board, PieceColor color, Move hashMove,
+                       const OrderingTables& tables, int ply, MoveList& moves)
+    : board(board), color(color), tables(tables), ply(ply), stage(HASH_MOVE), capturesOnly(false),
+      hashMove(hashMove), killerIndex(0), moves(moves), index(0) {
+    if (ply < MAX_PLY) {
+        killers[0] = tables.killers[ply][0];
+        killers[1] = tables.killers[ply][1];
+    }
+}
+
+MovePicker::MovePicker(const Board& board, PieceColor color, const OrderingTables& tables, MoveList& moves)
+    : board(board), color(color), tables(tables), ply(0), stage(GENERATE_CAPTURES), capturesOnly(true),
+      killerIndex(0), moves(moves), index(0) {}
+
+bool MovePicker::alreadyTried(Move move) const {
+    if (move == hashMove) return true;
+    if (stage == QUIETS) {
+        return move == killers[0] || move == killers[1];
+    }
+    return false;
+}
+
+Move MovePicker::pickBest() {
+    int best = index;
+    for (int i = index + 1; i < moves.count; i++) {
+        if (moves.moves[i].score > moves.moves[best].score) best = i;
+    }
+    std::swap(moves.moves[index], moves.moves[best]);
+    return moves.moves[index++].move;
+}
+
+bool MovePicker::next(Move& move) {
+    while (true) {
+        switch (stage) {
+            case HASH_MOVE:
+                stage = GENERATE_CAPTURES;
+                if (isLegalMove(board, hashMove)) {
+                    move = hashMove;
+                    return true;
+                }
+                hashMove = Move();
+                break;
+                
+            case GENERATE_CAPTURES:
+                moves.clear();
+                generateCaptures(board, moves);
+                for (int i = 0; i < moves.count; i++) {
+                    ScoredMove& capture = moves.moves[i];
+                    Move candidate = capture.move;
+                    PieceType victim = board.pieceAt(candidate.to()).type;
+                    if (candidate.flag() == EN_PASSANT) victim = PAWN;
+                    capture.score = pieceValues[victim] * 1000 - pieceValues[board.pieceAt(candidate.from()).type];
+                    if (candidate.flag() == PROMOTION) capture.score += pieceValues[candidate.promotion()] * 1000;
+                }
+                index = 0;
+                stage = CAPTURES;
+                break;
+                
+            case CAPTURES:
+                while (index < moves.count) {
+                    Move candidate = pickBest();
+                    if (capturesOnly && ((candidate.flag() == PROMOTION && candidate.promotion() != QUEEN) ||
+                                         staticExchange(board, candidate) < 0)) {
+                        continue;
+                    }
+                    if (!alreadyTried(candidate)) {
+                        move = candidate;
+                        return true;
+                    }
+                }
+                stage = capturesOnly ? DONE : KILLERS;
+                break;
+                
+            case KILLERS:
+                while (killerIndex < 2) {
+                    Move& killer = killers[killerIndex++];
+                    // Killers are quiet moves; anything else came from
+                    // another position and was already tried as a capture.
+                    if (killer == hashMove || killer.flag() == PROMOTION || killer.flag() == EN_PASSANT ||
+                        board.pieceAt(killer.to()).type != EMPTY || !isLegalMove(board, killer)) {
+                        killer = Move();
+                        continue;
+                    }
+                    move = killer;
+                    return true;
+                }
+                stage = GENERATE_QUIETS;
+                break;
+                
+            case GENERATE_QUIETS:
+                moves.clear();
+                generateQuiets(board, moves);
+                for (int i = 0; i < moves.count; i++) {
+                    ScoredMove& quiet = moves.moves[i];
+                    quiet.score = tables.history[color][quiet.move.from()][quiet.move.to()];
+                }
+                index = 0;
+                stage = QUIETS;
+                break;
+                
+            case QUIETS:
+                while (index < moves.count) {
+                    Move candidate = pickBest();
+                    if (!alreadyTried(candidate)) {
+                        move = candidate;
+                        return true;
+                    }
+                }
+                stage = DONE;
+                break;
+                
+            case DONE:
+                return false;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef CHESS_ENGINE_MOVEORDER_H
+#define CHESS_ENGINE_MOVEORDER_H
+
+#include "board.h"
+#include "movegen.h"
+
+// Deepest ply the search can reach, including any extensions.
+const int MAX_PLY = 128;
+
+// Quiet-move history gathered by one search thread: two killer moves per
+// ply and a butterfly table scored by the depth of the cutoffs they caused.
+struct OrderingTables {
+    Move killers[MAX_PLY][2];
+    int history[3][64][64];  // [color][from][to]
+    
+    OrderingTables() { clear(); }
+    
+    void clear();
+    
+    // Called once per search so old history fades instead of dominating.
+    void age();
+    
+    // A quiet move by `color` caused a beta cutoff at this ply and
+    // remaining depth.
+    void recordCutoff(PieceColor color, Move move, int ply, int depth);
+};
+
+// Yields the moves of one node best-first, in stages, so that a cutoff on
+// an early move saves generating the rest:
+//   1. the transposition table move
+//   2. captures, most valuable victim first, then least valuable attacker
+//   3. the two killer moves for this ply
+//   4. remaining quiet moves by history score
+// Moves are generated into `moves`, which the caller owns (one list per
+// ply), so picking never allocates. The hash and killer moves can come from
+// another position and are checked with isLegalMove before being played.
+class MovePicker {
+public:
+    MovePicker(const Board& board, PieceColor color, Move hashMove,
+               const OrderingTables& tables, int ply, MoveList& moves);
+    
+    // Quiescence search: captures only, in the same order, skipping those
+    // that lose material by static exchange evaluation and promotions to
+    // anything but a queen.
+    MovePicker(const Board& board, PieceColor color, const OrderingTables& tables, MoveList& moves);
+    
+    bool next(Move& move);
+
+private:
+    enum Stage {
+        HASH_MOVE,
+        GENERATE_CAPTURES,
+        CAPTURES,
+        KILLERS,
+        GENERATE_QUIETS,
+        QUIETS,
+        DONE
+    };
+    
+    bool alreadyTried(Move move) const;
+    
+    // Swaps the highest-scoring remaining move to `index` and returns it.
+    Move pickBest();
+    
+    const Board& board;
+    PieceColor color;
+    const OrderingTables& tables;
+    int ply;
+    
+    Stage stage;
+    bool capturesOnly;
+    Move hashMove;
+    Move killers[2];
+    int killerIndex;
+    MoveList& moves;
+    int index;
+};
+
+#endif
@@ -0,0 +1,430 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "board.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHESS_NNUE_X86
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nnue {
+
+namespace {
+
+// The layers after the feature transformer, as the kernels read them.
+struct Dense {
+    const int32_t* hidden1Biases;
+    const int8_t* hidden1Weights;
+    const int32_t* hidden2Biases;
+    const int8_t* hidden2Weights;
+    int32_t outputBias;
+    const int8_t* outputWeights;
+};
+
+// One implementation per instruction set, picked once at startup; all of
+// them compute exactly the same integers.
+struct Kernels {
+    const char* name;
+    void (*add)(int16_t* values, const int16_t* column);
+    void (*subtract)(int16_t* values, const int16_t* column);
+    // Output of the network for the side whose half is `us`.
+    int32_t (*propagate)(const Dense& dense, const int16_t* us, const int16_t* them);
+};
+
+// Hidden-layer sums back to 0-127 activations.
+inline uint8_t activate(int32_t sum) {
+    return uint8_t(std::min(std::max(sum >> WEIGHT_SHIFT, 0), 127));
+}
+
+inline uint8_t clip(int16_t value) {
+    return uint8_t(std::min(std::max(int(value), 0), 127));
+}
+
+void addScalar(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < HALF_DIMENSIONS; i++) {
+        values[i] = int16_t(values[i] + column[i]);
+    }
+}
+
+void subtractScalar(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < HALF_DIMENSIONS; i++) {
+        values[i] = int16_t(values[i] - column[i]);
+    }
+}
+
+// Inputs that are zero, most of them in practice, are skipped.
+void denseScalar(const uint8_t* input, int inputs, const int32_t* biases, const int8_t* weights, uint8_t* output) {
+    int32_t sums[HIDDEN];
+    std::copy(biases, biases + HIDDEN, sums);
+    for (int i = 0; i < inputs; i++) {
+        if (input[i] == 0) continue;
+        const int8_t* column = weights + denseIndex(0, i);
+        for (int j = 0; j < HIDDEN; j++) {
+            sums[j] += int32_t(input[i]) * column[4 * j];
+        }
+    }
+    for (int j = 0; j < HIDDEN; j++) {
+        output[j] = activate(sums[j]);
+    }
+}
+
+int32_t propagateScalar(const Dense& dense, const int16_t* us, const int16_t* them) {
+    uint8_t input[2 * HALF_DIMENSIONS];
+    for (int i = 0; i < HALF_DIMENSIONS; i++) {
+        input[i] = clip(us[i]);
+        input[HALF_DIMENSIONS + i] = clip(them[i]);
+    }
+    uint8_t hidden1[HIDDEN], hidden2[HIDDEN];
+    denseScalar(input, 2 * HALF_DIMENSIONS, dense.hidden1Biases, dense.hidden1Weights, hidden1);
+    denseScalar(hidden1, HIDDEN, dense.hidden2Biases, dense.hidden2Weights, hidden2);
+    int32_t output = dense.outputBias;
+    for (int i = 0; i < HIDDEN; i++) {
+        output += int32_t(hidden2[i]) * dense.outputWeights[i];
+    }
+    return output;
+}
+
+#ifdef CHESS_NNUE_X86
+
+// The dense layers take their input four bytes at a time: each group is
+// broadcast, maddubs multiplies it by the group's weights for every output
+// into pairs of int16 sums (which cannot saturate at 127 * 128 * 2), and
+// madd with ones widens those into each output's int32 sum. Groups that
+// are all zero are left out of the first layer.
+
+// Positions of the non-zero four-byte groups of `input`, found without
+// branching on each one.
+inline int nonZeroGroups(const uint8_t* input, int inputs, int* groups) {
+    int count = 0;
+    for (int i = 0; i < inputs / 4; i++) {
+        uint32_t group;
+        std::memcpy(&group, input + 4 * i, 4);
+        groups[count] = i;
+        count += (group != 0);
+    }
+    return count;
+}
+
+__attribute__((target("sse4.1"))) void addSse41(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < HALF_DIMENSIONS; i += 8) {
+        __m128i* target = reinterpret_cast<__m128i*>(values + i);
+        __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + i));
+        _mm_storeu_si128(target, _mm_add_epi16(_mm_loadu_si128(target), weights));
+    }
+}
+
+__attribute__((target("sse4.1"))) void subtractSse41(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < HALF_DIMENSIONS; i += 8) {
+        __m128i* target = reinterpret_cast<__m128i*>(values + i);
+        __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + i));
+        _mm_storeu_si128(target, _mm_sub_epi16(_mm_loadu_si128(target), weights));
+    }
+}
+
+__attribute__((target("sse4.1"))) inline void clipSse41(const int16_t* values, uint8_t* out) {
+    for (int i = 0; i < HALF_DIMENSIONS; i += 16) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 8));
+        __m128i packed = _mm_max_epi8(_mm_packs_epi16(low, high), _mm_setzero_si128());
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+    }
+}
+
+__attribute__((target("sse4.1"))) inline void denseSse41(const uint8_t* input, const int* groups, int count,
+                                                          const int32_t* biases, const int8_t* weights,
+                                                          uint8_t* output) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sums[HIDDEN / 4];
+    for (int j = 0; j < HIDDEN / 4; j++) {
+        sums[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(biases + 4 * j));
+    }
+    for (int i = 0; i < count; i++) {
+        uint32_t group;
+        std::memcpy(&group, input + 4 * groups[i], 4);
+        __m128i in = _mm_set1_epi32(int(group));
+        const int8_t* column = weights + size_t(groups[i]) * HIDDEN * 4;
+        for (int j = 0; j < HIDDEN / 4; j++) {
+            __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + 16 * j));
+            sums[j] = _mm_add_epi32(sums[j], _mm_madd_epi16(_mm_maddubs_epi16(in, w), ones));
+        }
+    }
+    for (int j = 0; j < HIDDEN / 4; j += 4) {
+        __m128i low = _mm_packs_epi32(_mm_srai_epi32(sums[j], WEIGHT_SHIFT), _mm_srai_epi32(sums[j + 1], WEIGHT_SHIFT));
+        __m128i high =
+            _mm_packs_epi32(_mm_srai_epi32(sums[j + 2], WEIGHT_SHIFT), _mm_srai_epi32(sums[j + 3], WEIGHT_SHIFT));
+        __m128i packed = _mm_max_epi8(_mm_packs_epi16(low, high), _mm_setzero_si128());
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4 * j), packed);
+    }
+}
+
+__attribute__((target("sse4.1"))) int32_t propagateSse41(const Dense& dense, const int16_t* us, const int16_t* them) {
+    uint8_t input[2 * HALF_DIMENSIONS];
+    clipSse41(us, input);
+    clipSse41(them, input + HALF_DIMENSIONS);
+    int groups[2 * HALF_DIMENSIONS / 4];
+    int count = nonZeroGroups(input, 2 * HALF_DIMENSIONS, groups);
+    uint8_t hidden1[HIDDEN], hidden2[HIDDEN];
+    denseSse41(input, groups, count, dense.hidden1Biases, dense.hidden1Weights, hidden1);
+    const int allGroups[HIDDEN / 4] = {0, 1, 2, 3, 4, 5, 6, 7};
+    denseSse41(hidden1, allGroups, HIDDEN / 4, dense.hidden2Biases, dense.hidden2Weights, hidden2);
+    
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hidden2 + i));
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dense.outputWeights + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(in, w), ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return dense.outputBias + _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2"))) void addAvx2(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < HALF_DIMENSIONS; i += 16) {
+        __m256i* target = reinterpret_cast<__m256i*>(values + i);
+        __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + i));
+        _mm256_storeu_si256(target, _mm256_add_epi16(_mm256_loadu_si256(target), weights));
+    }
+}
+
+__attribute__((target("avx2"))) void subtractAvx2(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < HALF_DIMENSIONS; i += 16) {
+        __m256i* target = reinterpret_cast<__m256i*>(values + i);
+        __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + i));
+        _mm256_storeu_si256(target, _mm256_sub_epi16(_mm256_loadu_si256(target), weights));
+    }
+}
+
+// packs works within each 128-bit lane, so the quarters come out as
+// low[0-7], high[0-7], low[8-15], high[8-15] and are put back in order.
+__attribute__((target("avx2"))) inline void clipAvx2(const int16_t* values, uint8_t* out) {
+    for (int i = 0; i < HALF_DIMENSIONS; i += 32) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 16));
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(low, high), _mm256_setzero_si256());
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+}
+
+// The same lane split leaves the outputs' groups of four in the order 0, 2,
+// 4, 6, 1, 3, 5, 7, which the final permute undoes.
+__attribute__((target("avx2"))) inline void denseAvx2(const uint8_t* input, const int* groups, int count,
+                                                       const int32_t* biases, const int8_t* weights,
+                                                       uint8_t* output) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sums[HIDDEN / 8];
+    for (int j = 0; j < HIDDEN / 8; j++) {
+        sums[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(biases + 8 * j));
+    }
+    for (int i = 0; i < count; i++) {
+        uint32_t group;
+        std::memcpy(&group, input + 4 * groups[i], 4);
+        __m256i in = _mm256_set1_epi32(int(group));
+        const int8_t* column = weights + size_t(groups[i]) * HIDDEN * 4;
+        for (int j = 0; j < HIDDEN / 8; j++) {
+            __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + 32 * j));
+            sums[j] = _mm256_add_epi32(sums[j], _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones));
+        }
+    }
+    __m256i low =
+        _mm256_packs_epi32(_mm256_srai_epi32(sums[0], WEIGHT_SHIFT), _mm256_srai_epi32(sums[1], WEIGHT_SHIFT));
+    __m256i high =
+        _mm256_packs_epi32(_mm256_srai_epi32(sums[2], WEIGHT_SHIFT), _mm256_srai_epi32(sums[3], WEIGHT_SHIFT));
+    __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(low, high), _mm256_setzero_si256());
+    packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), packed);
+}
+
+__attribute__((target("avx2"))) int32_t propagateAvx2(const Dense& dense, const int16_t* us, const int16_t* them) {
+    uint8_t input[2 * HALF_DIMENSIONS];
+    clipAvx2(us, input);
+    clipAvx2(them, input + HALF_DIMENSIONS);
+    int groups[2 * HALF_DIMENSIONS / 4];
+    int count = nonZeroGroups(input, 2 * HALF_DIMENSIONS, groups);
+    uint8_t hidden1[HIDDEN], hidden2[HIDDEN];
+    denseAvx2(input, groups, count, dense.hidden1Biases, dense.hidden1Weights, hidden1);
+    const int allGroups[HIDDEN / 4] = {0, 1, 2, 3, 4, 5, 6, 7};
+    denseAvx2(hidden1, allGroups, HIDDEN / 4, dense.hidden2Biases, dense.hidden2Weights, hidden2);
+    
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hidden2));
+    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dense.outputWeights));
+    __m256i sum = _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones);
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return dense.outputBias + _mm_cvtsi128_si32(half);
+}
+
+#endif
+
+Kernels selectKernels() {
+#ifdef CHESS_NNUE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Kernels{"avx2", addAvx2, subtractAvx2, propagateAvx2};
+    if (__builtin_cpu_supports("sse4.1")) return Kernels{"sse4.1", addSse41, subtractSse41, propagateSse41};
+#endif
+    return Kernels{"scalar", addScalar, subtractScalar, propagateScalar};
+}
+
+const Kernels kernels = selectKernels();
+
+uint32_t readLittleEndian(const unsigned char* bytes) {
+    return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+}
+
+bool validHeader(const unsigned char* bytes, size_t size) {
+    return size == fileLayout().size && std::memcmp(bytes, MAGIC, sizeof(MAGIC)) == 0 &&
+           readLittleEndian(bytes + 8) == uint32_t(FEATURES) &&
+           readLittleEndian(bytes + 12) == uint32_t(HALF_DIMENSIONS) && readLittleEndian(bytes + 16) == uint32_t(HIDDEN);
+}
+
+}
+
+Network::Network()
+    : data(nullptr), length(0), featureBiases(nullptr), featureWeights(nullptr), hidden1Biases(nullptr),
+      hidden1Weights(nullptr), hidden2Biases(nullptr), hidden2Weights(nullptr), outputBias(nullptr),
+      outputWeights(nullptr) {}
+
+Network::~Network() {
+    close();
+}
+
+#ifdef _WIN32
+
+// No mmap here; the network is read into memory instead.
+bool Network::open(const std::string& path) {
+    close();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!validHeader(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size())) return false;
+    
+    unsigned char* copy = new unsigned char[bytes.size()];
+    std::copy(bytes.begin(), bytes.end(), copy);
+    data = copy;
+    length = bytes.size();
+    setParts();
+    return true;
+}
+
+void Network::close() {
+    delete[] data;
+    data = nullptr;
+    length = 0;
+}
+
+#else
+
+bool Network::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) != fileLayout().size) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    
+    data = static_cast<const unsigned char*>(mapping);
+    length = size_t(info.st_size);
+    if (!validHeader(data, length)) {
+        close();
+        return false;
+    }
+    setParts();
+    return true;
+}
+
+void Network::close() {
+    if (data) munmap(const_cast<unsigned char*>(data), length);
+    data = nullptr;
+    length = 0;
+}
+
+#endif
+
+void Network::setParts() {
+    const FileLayout layout = fileLayout();
+    featureBiases = reinterpret_cast<const int16_t*>(data + layout.featureBiases);
+    featureWeights = reinterpret_cast<const int16_t*>(data + layout.featureWeights);
+    hidden1Biases = reinterpret_cast<const int32_t*>(data + layout.hidden1Biases);
+    hidden1Weights = reinterpret_cast<const int8_t*>(data + layout.hidden1Weights);
+    hidden2Biases = reinterpret_cast<const int32_t*>(data + layout.hidden2Biases);
+    hidden2Weights = reinterpret_cast<const int8_t*>(data + layout.hidden2Weights);
+    outputBias = reinterpret_cast<const int32_t*>(data + layout.outputBias);
+    outputWeights = reinterpret_cast<const int8_t*>(data + layout.outputWeights);
+}
+
+void Network::refresh(const BitboardPosition& bitboards, PieceColor perspective, Accumulator& accumulator) const {
+    int16_t* values = accumulator.values[perspective];
+    std::memcpy(values, featureBiases, sizeof(accumulator.values[perspective]));
+    
+    Bitboard king = bitboards.pieces[perspective][KING];
+    int kingSquare = king ? lsb(king) : 0;
+    for (PieceColor color : {WHITE, BLACK}) {
+        for (int type = PAWN; type < KING; type++) {
+            Piece piece(PieceType(type), color);
+            for (Bitboard b = bitboards.pieces[color][type]; b;) {
+                int feature = featureIndex(perspective, kingSquare, piece, popLSB(b));
+                kernels.add(values, featureWeights + size_t(feature) * HALF_DIMENSIONS);
+            }
+        }
+    }
+    accumulator.valid[perspective] = true;
+}
+
+void Network::update(const BitboardPosition& bitboards, int square, const Piece& removed, const Piece& added,
+                     Accumulator& accumulator) const {
+    if (removed.type == KING) accumulator.valid[removed.color] = false;
+    if (added.type == KING) accumulator.valid[added.color] = false;
+    
+    for (PieceColor perspective : {WHITE, BLACK}) {
+        if (!accumulator.valid[perspective]) continue;
+        int kingSquare = lsb(bitboards.pieces[perspective][KING]);
+        int16_t* values = accumulator.values[perspective];
+        if (removed.type != EMPTY && removed.type != KING) {
+            int feature = featureIndex(perspective, kingSquare, removed, square);
+            kernels.subtract(values, featureWeights + size_t(feature) * HALF_DIMENSIONS);
+        }
+        if (added.type != EMPTY && added.type != KING) {
+            int feature = featureIndex(perspective, kingSquare, added, square);
+            kernels.add(values, featureWeights + size_t(feature) * HALF_DIMENSIONS);
+        }
+    }
+}
+
+int Network::evaluate(const Accumulator& accumulator, PieceColor side) const {
+    Dense dense{hidden1Biases, hidden1Weights, hidden2Biases, hidden2Weights, *outputBias, outputWeights};
+    int32_t output = kernels.propagate(dense, accumulator.values[side], accumulator.values[opponent(side)]);
+    return output / OUTPUT_SCALE;
+}
+
+int evaluate(const Board& board) {
+    return board.getNetwork()->evaluate(board.getAccumulator(), board.getCurrentPlayer());
+}
+
+const char* simdName() {
+    return kernels.name;
+}
+
+}
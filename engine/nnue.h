@@ -0,0 +1,155 @@
+#ifndef CHESS_ENGINE_NNUE_H
+#define CHESS_ENGINE_NNUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+struct BitboardPosition;
+class Board;
+
+// Efficiently updatable neural network evaluation, an alternative to the
+// classical one in evaluate.h.
+//
+// Inputs are HalfKP features: for each side (the "perspective"), one per
+// non-king piece on a square, relative to that side's king square. Each
+// perspective sees the board from its own side, with Black's mirrored
+// vertically, so a position and its colour-flipped twin look the same.
+// The first layer (the feature transformer) is a sum of one weight column
+// per active feature; the board keeps that sum, the accumulator, for both
+// perspectives and updates it as pieces move, so only the small layers
+// after it run per evaluation:
+//
+//   2 x 40960 features -> 2 x 128 (int16) -> 32 -> 32 -> 1
+//
+// The small layers take 0-127 activations as bytes and have int8 weights.
+namespace nnue {
+
+const int KING_SQUARES = 64;
+const int PIECE_FEATURES = 10 * 64;  // ten non-king pieces, own first, on 64 squares
+const int FEATURES = KING_SQUARES * PIECE_FEATURES;
+const int HALF_DIMENSIONS = 128;
+const int HIDDEN = 32;
+
+// Hidden-layer weights are fixed point with this many fractional bits.
+const int WEIGHT_SHIFT = 6;
+// The network's output per centipawn.
+const int OUTPUT_SCALE = 8;
+
+// Both perspectives' first-layer sums, indexed by PieceColor. A perspective
+// that is not valid is recomputed from the pieces on its next use; a king
+// move invalidates its own side's, since every feature of it changes.
+struct Accumulator {
+    int16_t values[3][HALF_DIMENSIONS];
+    bool valid[3];
+    
+    Accumulator() : values(), valid() {}
+};
+
+// Byte offsets of the parts of a network file. The file starts with a
+// 64-byte header (the magic, then the three dimensions as 32-bit integers)
+// and every part is 64-byte aligned, so the mapped file is used in place.
+// All numbers are little-endian.
+struct FileLayout {
+    size_t featureBiases;   // int16[HALF_DIMENSIONS]
+    size_t featureWeights;  // int16[FEATURES][HALF_DIMENSIONS]
+    size_t hidden1Biases;   // int32[HIDDEN]
+    size_t hidden1Weights;  // int8[HIDDEN][2 * HALF_DIMENSIONS] by denseIndex, side to move's half first
+    size_t hidden2Biases;   // int32[HIDDEN]
+    size_t hidden2Weights;  // int8[HIDDEN][HIDDEN], by denseIndex
+    size_t outputBias;      // int32
+    size_t outputWeights;   // int8[HIDDEN]
+    size_t size;
+};
+
+constexpr size_t alignPart(size_t offset) { return (offset + 63) & ~size_t(63); }
+
+constexpr FileLayout fileLayout() {
+    FileLayout layout{};
+    layout.featureBiases = 64;
+    layout.featureWeights = alignPart(layout.featureBiases + HALF_DIMENSIONS * sizeof(int16_t));
+    layout.hidden1Biases = alignPart(layout.featureWeights + size_t(FEATURES) * HALF_DIMENSIONS * sizeof(int16_t));
+    layout.hidden1Weights = alignPart(layout.hidden1Biases + HIDDEN * sizeof(int32_t));
+    layout.hidden2Biases = alignPart(layout.hidden1Weights + HIDDEN * 2 * HALF_DIMENSIONS);
+    layout.hidden2Weights = alignPart(layout.hidden2Biases + HIDDEN * sizeof(int32_t));
+    layout.outputBias = alignPart(layout.hidden2Weights + HIDDEN * HIDDEN);
+    layout.outputWeights = alignPart(layout.outputBias + sizeof(int32_t));
+    layout.size = alignPart(layout.outputWeights + HIDDEN);
+    return layout;
+}
+
+// Where a hidden layer keeps the weight from `input` to `output`: inputs
+// are taken in groups of four, and each group's weights for all outputs are
+// stored together, so the weights of an input group that is all zero are
+// never read.
+inline size_t denseIndex(int output, int input) {
+    return (size_t(input / 4) * HIDDEN + output) * 4 + input % 4;
+}
+
+const char MAGIC[8] = {'E', 'C', 'N', 'N', 'U', 'E', '0', '1'};
+
+// Column of the feature transformer for `piece` on `square`, seen by
+// `perspective` with its king on `kingSquare`. Kings are not features.
+inline int featureIndex(PieceColor perspective, int kingSquare, const Piece& piece, int square) {
+    int flip = (perspective == WHITE) ? 0 : 56;
+    int kind = (piece.type - PAWN) + (piece.color == perspective ? 0 : 5);
+    return (kingSquare ^ flip) * PIECE_FEATURES + kind * 64 + (square ^ flip);
+}
+
+// Network weights, mapped read-only from a file like the opening book, so
+// searches on any number of threads share one copy.
+class Network {
+public:
+    Network();
+    ~Network();
+    
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+    
+    // False if the file is missing or is not a network of these dimensions.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    
+    // Recomputes one perspective from the pieces.
+    void refresh(const BitboardPosition& bitboards, PieceColor perspective, Accumulator& accumulator) const;
+    
+    // Applies a board write of `added` over `removed` on `square` to the
+    // valid perspectives; called before the bitboards change.
+    void update(const BitboardPosition& bitboards, int square, const Piece& removed, const Piece& added,
+                Accumulator& accumulator) const;
+    
+    // Score in centipawns from `side`'s point of view; both perspectives
+    // must be valid.
+    int evaluate(const Accumulator& accumulator, PieceColor side) const;
+
+private:
+    // Points the parts below into the file.
+    void setParts();
+    
+    const unsigned char* data;
+    size_t length;
+    
+    const int16_t* featureBiases;
+    const int16_t* featureWeights;
+    const int32_t* hidden1Biases;
+    const int8_t* hidden1Weights;
+    const int32_t* hidden2Biases;
+    const int8_t* hidden2Weights;
+    const int32_t* outputBias;
+    const int8_t* outputWeights;
+};
+
+// Score of the board's position with its network, from the side to move's
+// point of view.
+int evaluate(const Board& board);
+
+// The instruction set the kernels were picked for at startup: "avx2",
+// "sse4.1" or "scalar".
+const char* simdName();
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "notation.h"
+
+#include "movegen.h"
+
+namespace {
+
+const char pieceLetters[7] = {' ', 'P', 'R', 'N', 'B', 'Q', 'K'};
+
+std::string squareName(int square) {
+    std::string name;
+    name += char('a' + square % 8);
+    name += char('8' - square / 8);
+    return name;
+}
+
+// SAN without the check or mate mark.
+std::string sanBody(const Board& board, const MoveList& legal, Move move) {
+    int from = move.from();
+    int to = move.to();
+    PieceType piece = board.pieceAt(from).type;
+    
+    if (move.flag() == CASTLING) {
+        return (to % 8 == 6) ? "O-O" : "O-O-O";
+    }
+    
+    bool capture = board.pieceAt(to).type != EMPTY || move.flag() == EN_PASSANT;
+    std::string san;
+    if (piece == PAWN) {
+        if (capture) san += char('a' + from % 8);
+    } else {
+        san += pieceLetters[piece];
+        
+        // Name the file, the rank or both, whichever tells this piece apart
+        // from others of its kind that can reach the same square.
+        bool ambiguous = false, sameFile = false, sameRank = false;
+        for (int i = 0; i < legal.count; i++) {
+            Move other = legal.moves[i].move;
+            if (other.to() != to || other.from() == from || board.pieceAt(other.from()).type != piece) continue;
+            ambiguous = true;
+            if (other.from() % 8 == from % 8) sameFile = true;
+            if (other.from() / 8 == from / 8) sameRank = true;
+        }
+        if (ambiguous) {
+            if (!sameFile) {
+                san += char('a' + from % 8);
+            } else if (!sameRank) {
+                san += char('8' - from / 8);
+            } else {
+                san += squareName(from);
+            }
+        }
+    }
+    if (capture) san += 'x';
+    san += squareName(to);
+    if (move.flag() == PROMOTION) {
+        san += '=';
+        san += pieceLetters[move.promotion()];
+    }
+    return san;
+}
+
+// Drops check marks and annotations, and accepts castling written with
+// zeros.
+std::string normalize(const std::string& text) {
+    std::string result;
+    for (char ch : text) {
+        if (ch == '+' || ch == '#' || ch == '!' || ch == '?') continue;
+        result += (ch == '0') ? 'O' : ch;
+    }
+    return result;
+}
+
+}
+
+std::string moveToSan(const Board& board, Move move) {
+    MoveList legal;
+    generateMoves(board, legal);
+    std::string san = sanBody(board, legal, move);
+    
+    Board after = board;
+    MoveRecord record;
+    after.makeTemporaryMove(move, record);
+    if (isInCheck(after)) {
+        MoveList replies;
+        generateMoves(after, replies);
+        san += replies.empty() ? '#' : '+';
+    }
+    return san;
+}
+
+Move parseMove(const Board& board, const std::string& text) {
+    std::string wanted = normalize(text);
+    if (wanted.empty()) return Move();
+    
+    MoveList legal;
+    generateMoves(board, legal);
+    for (int i = 0; i < legal.count; i++) {
+        Move move = legal.moves[i].move;
+        if (sanBody(board, legal, move) == wanted || moveToString(move) == text) return move;
+    }
+    return Move();
+}
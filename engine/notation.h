@@ -0,0 +1,17 @@
+#ifndef CHESS_ENGINE_NOTATION_H
+#define CHESS_ENGINE_NOTATION_H
+
+#include <string>
+
+#include "board.h"
+
+// Standard algebraic notation for a legal move of the side to move, e.g.
+// "Nbd7", "exd5", "O-O" or "e8=Q+".
+std::string moveToSan(const Board& board, Move move);
+
+// The legal move written as SAN or coordinate notation ("e7e8q"); check
+// marks and annotations such as "+", "#", "!" and "?" are ignored. Null if
+// no legal move matches.
+Move parseMove(const Board& board, const std::string& text);
+
+#endif
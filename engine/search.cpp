@@ -0,0 +1,653 @@
+#include "search.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "evaluate.h"
+#include "movegen.h"
+
+namespace {
+
+const int ASPIRATION_WINDOW = 25;
+const int ASPIRATION_MIN_DEPTH = 4;
+const int NULL_MOVE_MIN_DEPTH = 3;
+const int FUTILITY_MARGIN = 200;  // per ply of remaining depth
+const int FUTILITY_MAX_DEPTH = 2;
+const int LMR_MIN_DEPTH = 3;
+const int LMR_MIN_MOVES = 3;
+
+// Reductions grow with both the remaining depth and how late the move
+// comes in the ordering.
+struct ReductionTable {
+    int plies[MAX_DEPTH + 1][MAX_MOVES];
+    
+    ReductionTable() {
+        for (int depth = 0; depth <= MAX_DEPTH; depth++) {
+            for (int moves = 0; moves < MAX_MOVES; moves++) {
+                plies[depth][moves] =
+                    (depth > 0 && moves > 0) ? int(0.75 + std::log(depth) * std::log(moves) / 2.25) : 0;
+            }
+        }
+    }
+};
+
+const ReductionTable reductionTable;
+
+int lateMoveReduction(int depth, int moveCount) {
+    return reductionTable.plies[std::min(depth, MAX_DEPTH)][std::min(moveCount, MAX_MOVES - 1)];
+}
+
+}
+
+SearchLimits SearchLimits::fixedDepth(int depth) {
+    SearchLimits limits;
+    limits.depth = depth;
+    return limits;
+}
+
+SearchLimits SearchLimits::forDifficulty(int aiDifficulty) {
+    // Easy and Medium keep their old depth caps so they stay beatable; Hard
+    // goes as deep as its time allows.
+    SearchLimits limits;
+    switch (aiDifficulty) {
+        case 1:
+            limits.depth = 2;
+            limits.timeMs = 200;
+            break;
+        case 2:
+            limits.depth = 3;
+            limits.timeMs = 600;
+            break;
+        default:
+            limits.timeMs = 1500;
+            break;
+    }
+    // Noise keeps its original size of 50 pawns per level below Hard.
+    limits.randomFactor = (3.0 - aiDifficulty) * 50.0 * pieceValues[PAWN];
+    if (limits.randomFactor < 0) limits.randomFactor = 0;
+    return limits;
+}
+
+Search::Search(size_t hashMegabytes)
+    : Search(std::make_shared<TranspositionTable>(hashMegabytes)) {}
+
+Search::Search(std::shared_ptr<TranspositionTable> sharedTable)
+    : tt(std::move(sharedTable)), moveStack(new MoveList[MAX_PLY]), rootCount(0), rootMaterial(0), ply(0), nodes(0),
+      helperStop(false), stopFlag(nullptr), ponderFlag(nullptr), stopped(false), completedDepth(0) {}
+
+void Search::setThreads(int count) {
+    helpers.clear();
+    for (int i = 1; i < count; i++) {
+        helpers.emplace_back(new Search(tt));
+        helpers.back()->setStopFlag(&helperStop);
+        helpers.back()->options = options;
+        helpers.back()->bitbases = bitbases;
+    }
+}
+
+void Search::setOptions(const SearchOptions& searchOptions) {
+    options = searchOptions;
+    for (std::unique_ptr<Search>& helper : helpers) {
+        helper->options = searchOptions;
+    }
+}
+
+uint64_t Search::getNodes() const {
+    uint64_t total = nodes.load(std::memory_order_relaxed);
+    for (const std::unique_ptr<Search>& helper : helpers) {
+        total += helper->nodes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+SearchStats Search::getStats() const {
+    SearchStats total = stats;
+    for (const std::unique_ptr<Search>& helper : helpers) {
+        total.addCounters(helper->stats);
+    }
+    total.nodes = getNodes();
+    return total;
+}
+
+void Search::resetCounters(const SearchLimits& searchLimits) {
+    limits = searchLimits;
+    startTime = std::chrono::steady_clock::now();
+    stopped = false;
+    completedDepth = 0;
+    nodes.store(0, std::memory_order_relaxed);
+    stats.clear();
+    ply = 0;
+    ordering.age();
+}
+
+void Search::setPosition(const Board& position) {
+    board = position;
+    board.setNetwork(network.get());
+}
+
+void Search::orderHashMove(int count, const TTEntry& entry) {
+    if (entry.bestMove.isNull()) return;
+    
+    for (int i = 0; i < count; i++) {
+        if (rootMoves[i].move == entry.bestMove) {
+            std::rotate(rootMoves, rootMoves + i, rootMoves + i + 1);
+            return;
+        }
+    }
+}
+
+int Search::elapsedMs() const {
+    return int(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+}
+
+void Search::checkLimits() {
+    uint64_t count = nodes.load(std::memory_order_relaxed) + 1;
+    nodes.store(count, std::memory_order_relaxed);
+    
+    if (limits.nodes > 0 && count >= limits.nodes && !isPondering()) {
+        stopped = true;
+    }
+    // Reading the clock or a shared flag costs far more than a node, so only
+    // do it now and then.
+    if ((count & 1023) == 0) {
+        if (limits.timeMs > 0 && elapsedMs() >= limits.timeMs && !isPondering()) stopped = true;
+        if (stopFlag && stopFlag->load(std::memory_order_relaxed)) stopped = true;
+    }
+}
+
+int Search::staticEval(int alpha, int beta) {
+    if (board.getNetwork()) return nnue::evaluate(board);
+    if (board.getCurrentPlayer() == WHITE) return evaluateBoard(board, pawnTable, alpha, beta);
+    return -evaluateBoard(board, pawnTable, -beta, -alpha);
+}
+
+// Null-move pruning assumes passing is never the best move, which fails
+// in pawn endings where every move makes things worse (zugzwang).
+bool Search::hasNonPawnMaterial() const {
+    const BitboardPosition& bitboards = board.getBitboards();
+    PieceColor side = board.getCurrentPlayer();
+    return (bitboards.colors[side] & ~(bitboards.pieces[side][PAWN] | bitboards.pieces[side][KING])) != 0;
+}
+
+int Search::materialCount() const {
+    const BitboardPosition& bitboards = board.getBitboards();
+    return popCount(bitboards.occupied) + popCount(bitboards.pieces[WHITE][PAWN] | bitboards.pieces[BLACK][PAWN]);
+}
+
+int Search::bitbaseScore(bitbase::Result result) {
+    if (result == bitbase::DRAW) return 0;
+    int eval = std::min(std::max(staticEval(), -BITBASE_EVAL_LIMIT), BITBASE_EVAL_LIMIT);
+    return (result == bitbase::WIN) ? BITBASE_WIN_SCORE + eval : -BITBASE_WIN_SCORE + eval;
+}
+
+int Search::negamax(int depth, int alpha, int beta, bool allowNull) {
+    if (depth <= 0) {
+        return quiescence(alpha, beta);
+    }
+    checkLimits();
+    if (stopped) return 0;
+    if (ply >= MAX_PLY) {
+        return staticEval();
+    }
+    // Probing only below a conversion keeps the search from settling for
+    // any won position when it is already in the tables at the root.
+    bitbase::Result result;
+    if (bitbases && popCount(board.getBitboards().occupied) <= bitbase::MAX_PIECES && materialCount() < rootMaterial &&
+        bitbases->probe(board, result)) {
+        return bitbaseScore(result);
+    }
+    
+    // Only moves on the principal variation are searched with an open
+    // window; everything else only has to be proved worse than it.
+    bool pvNode = beta - alpha > 1;
+    uint64_t key = board.getKey();
+    TTEntry entry;
+    bool hit = tt->probe(key, entry);
+    SEARCH_STAT(stats.ttProbes++);
+    SEARCH_STAT(stats.ttHits += hit);
+    if (hit && !pvNode && entry.depth >= depth) {
+        int score = scoreFromTable(entry.score);
+        if (entry.bound == BOUND_EXACT) return score;
+        if (entry.bound == BOUND_LOWER && score >= beta) return score;
+        if (entry.bound == BOUND_UPPER && score <= alpha) return score;
+    }
+    
+    // The static score only decides futility near the leaves (against alpha
+    // less the margin) and the null move further up (against beta), neither
+    // of them on the principal variation, so it only has to be exact around
+    // that one bound.
+    bool inCheck = isInCheck(board);
+    int eval = -INFINITE_SCORE;
+    if (!pvNode && !inCheck) {
+        int bound = (depth <= FUTILITY_MAX_DEPTH) ? alpha - FUTILITY_MARGIN * depth : beta;
+        eval = staticEval(bound, bound);
+    }
+    
+    // If passing the turn still leaves us above beta after a reduced
+    // search, a real move almost certainly does too.
+    if (options.nullMove && allowNull && !pvNode && !inCheck && depth >= NULL_MOVE_MIN_DEPTH && eval >= beta &&
+        hasNonPawnMaterial()) {
+        int reduction = 3 + depth / 6;
+        MoveRecord record;
+        board.makeNullMove(record);
+        ply++;
+        int score = -negamax(depth - 1 - reduction, -beta, -beta + 1, false);
+        ply--;
+        board.undoNullMove(record);
+        if (stopped) return 0;
+        if (score >= beta) return isMateScore(score) ? beta : score;
+    }
+    
+    // Near the leaves, quiet moves cannot lift a position this far below
+    // alpha.
+    int futilityScore = eval + FUTILITY_MARGIN * depth;
+    bool futile = options.futilityPruning && !pvNode && !inCheck && depth <= FUTILITY_MAX_DEPTH &&
+                  !isMateScore(alpha) && futilityScore <= alpha;
+    
+    Move hashMove;
+    if (hit) hashMove = entry.bestMove;
+    MovePicker picker(board, board.getCurrentPlayer(), hashMove, ordering, ply, moveStack[ply]);
+    
+    int originalAlpha = alpha;
+    Move bestMove;
+    int bestScore = -INFINITE_SCORE;
+    int moveCount = 0;
+    Move move;
+    MoveRecord record;
+    
+    while (picker.next(move)) {
+        moveCount++;
+        bool quiet = board.pieceAt(move.to()).type == EMPTY && move.flag() != PROMOTION && move.flag() != EN_PASSANT;
+        
+        board.makeTemporaryMove(move, record);
+        bool givesCheck = isInCheck(board);
+        if (futile && quiet && !givesCheck && moveCount > 1) {
+            board.undoTemporaryMove(record);
+            bestScore = std::max(bestScore, futilityScore);
+            continue;
+        }
+        
+        ply++;
+        int score;
+        if (moveCount == 1) {
+            score = -negamax(depth - 1, -beta, -alpha, true);
+        } else {
+            // Late quiet moves are rarely best, so they get a shallower
+            // null-window search first and a full one only if they beat alpha.
+            int reduction = 0;
+            if (options.lateMoveReductions && depth >= LMR_MIN_DEPTH && moveCount > LMR_MIN_MOVES && quiet &&
+                !inCheck && !givesCheck) {
+                reduction = std::min(lateMoveReduction(depth, moveCount), depth - 2);
+            }
+            score = -negamax(depth - 1 - reduction, -alpha - 1, -alpha, true);
+            if (reduction > 0 && score > alpha) {
+                score = -negamax(depth - 1, -alpha - 1, -alpha, true);
+            }
+            if (score > alpha && score < beta) {
+                score = -negamax(depth - 1, -beta, -alpha, true);
+            }
+        }
+        ply--;
+        board.undoTemporaryMove(record);
+        if (stopped) return 0;
+        
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+            if (alpha >= beta) {
+                SEARCH_STAT(stats.betaCutoffs++);
+                SEARCH_STAT(stats.firstMoveCutoffs += (moveCount == 1));
+                if (quiet) {
+                    ordering.recordCutoff(record.piece.color, move, ply, depth);
+                }
+                break;
+            }
+        }
+    }
+    
+    if (moveCount == 0) {
+        return mateOrStalemate();
+    }
+    
+    BoundType bound = BOUND_EXACT;
+    if (bestScore >= beta) bound = BOUND_LOWER;
+    else if (bestScore <= originalAlpha) bound = BOUND_UPPER;
+    tt->store(key, depth, bound, scoreToTable(bestScore), bestMove);
+    
+    return bestScore;
+}
+
+int Search::quiescence(int alpha, int beta) {
+    checkLimits();
+    if (stopped) return 0;
+    SEARCH_STAT(stats.quiescenceNodes++);
+    if (ply >= MAX_PLY) return staticEval();
+    
+    // In check there is no standing pat: every evasion is searched, and
+    // having none is mate.
+    bool inCheck = isInCheck(board);
+    int bestScore = -INFINITE_SCORE;
+    if (!inCheck) {
+        // Not capturing is always an option, so the static score is a bound.
+        bestScore = staticEval(alpha, beta);
+        if (bestScore >= beta) return bestScore;
+        alpha = std::max(alpha, bestScore);
+    }
+    
+    PieceColor color = board.getCurrentPlayer();
+    MovePicker picker = inCheck ? MovePicker(board, color, Move(), ordering, ply, moveStack[ply])
+                                : MovePicker(board, color, ordering, moveStack[ply]);
+    int moveCount = 0;
+    Move move;
+    MoveRecord record;
+    
+    while (picker.next(move)) {
+        moveCount++;
+        board.makeTemporaryMove(move, record);
+        ply++;
+        int score = -quiescence(-beta, -alpha);
+        ply--;
+        board.undoTemporaryMove(record);
+        if (stopped) return 0;
+        
+        if (score > bestScore) {
+            bestScore = score;
+        }
+        if (score > alpha) {
+            alpha = score;
+            if (alpha >= beta) break;
+        }
+    }
+    
+    if (inCheck && moveCount == 0) return mateOrStalemate();
+    return bestScore;
+}
+
+int Search::mateOrStalemate() const {
+    return isInCheck(board) ? -(MATE_SCORE - ply) : 0;
+}
+// Mate scores count plies from the root, but a table entry can be reached
+// at any ply, so entries count from their own node instead.
+int Search::scoreToTable(int score) const {
+    if (score >= MATE_SCORE - MAX_PLY) return score + ply;
+    if (score <= -(MATE_SCORE - MAX_PLY)) return score - ply;
+    return score;
+}
+
+int Search::scoreFromTable(int score) const {
+    if (score >= MATE_SCORE - MAX_PLY) return score - ply;
+    if (score <= -(MATE_SCORE - MAX_PLY)) return score + ply;
+    return score;
+}
+
+void Search::setBook(std::shared_ptr<const OpeningBook> openingBook) {
+    book = std::move(openingBook);
+    if (book) bookRandom.seed(std::random_device()());
+}
+
+void Search::setNetwork(std::shared_ptr<const nnue::Network> evalNetwork) {
+    network = std::move(evalNetwork);
+    board.setNetwork(network.get());
+}
+
+void Search::setBitbases(std::shared_ptr<const bitbase::Bitbases> tables) {
+    bitbases = std::move(tables);
+    for (std::unique_ptr<Search>& helper : helpers) {
+        helper->bitbases = bitbases;
+    }
+}
+
+void Search::keepBitbaseMoves() {
+    bitbase::Result result;
+    if (!bitbases->probe(board, result) || result == bitbase::LOSS) return;
+    
+    // A won position needs a move to a lost one for the opponent, a drawn
+    // position one to a draw; moves into positions the tables miss stay.
+    bitbase::Result wanted = (result == bitbase::WIN) ? bitbase::LOSS : bitbase::DRAW;
+    int kept = 0;
+    for (int i = 0; i < rootCount; i++) {
+        MoveRecord record;
+        board.makeTemporaryMove(rootMoves[i].move, record);
+        bitbase::Result reply;
+        bool keep = !bitbases->probe(board, reply) || reply == wanted;
+        board.undoTemporaryMove(record);
+        if (keep) rootMoves[kept++] = rootMoves[i];
+    }
+    if (kept > 0) rootCount = kept;
+}
+
+Move Search::getBestMove(const SearchLimits& searchLimits) {
+    resetCounters(searchLimits);
+    if (book) {
+        Move bookMove = book->pick(board, bookRandom());
+        if (!bookMove.isNull()) return bookMove;
+    }
+    tt->newSearch();
+    
+    helperStop.store(false);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < helpers.size(); i++) {
+        Search* helper = helpers[i].get();
+        helper->board = board;
+        threads.emplace_back([helper, i]() { helper->runHelper(int(i) + 1); });
+    }
+    
+    Move bestMove = iterativeDeepening(0);
+    
+    helperStop.store(true);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    
+    // Reached the depth limit before the ponder ended: the move can only be
+    // handed back once the caller knows what was played.
+    while (isPondering() && !(stopFlag && stopFlag->load(std::memory_order_relaxed))) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stats.timeMs = elapsedMs();
+    return bestMove;
+}
+
+int Search::extractPV(Move first, Move* pv, int maxLength) {
+    MoveRecord records[MAX_PLY];
+    uint64_t keys[MAX_PLY];
+    int length = 0;
+    Move move = first;
+    
+    while (length < maxLength && !move.isNull()) {
+        if (!isLegalMove(board, move)) break;
+        keys[length] = board.getKey();
+        board.makeTemporaryMove(move, records[length]);
+        pv[length++] = move;
+        
+        bool repeated = false;
+        for (int i = 0; i < length; i++) {
+            if (keys[i] == board.getKey()) repeated = true;
+        }
+        TTEntry entry;
+        if (repeated || !tt->probe(board.getKey(), entry)) break;
+        move = entry.bestMove;
+    }
+    
+    for (int i = length - 1; i >= 0; i--) {
+        board.undoTemporaryMove(records[i]);
+    }
+    return length;
+}
+
+// `score` is from the side to move's point of view.
+void Search::reportIteration(int depth, int score, Move best) {
+    if (!infoCallback) return;
+    
+    SearchInfo info;
+    info.depth = depth;
+    info.score = (board.getCurrentPlayer() == WHITE) ? score : -score;
+    info.nodes = getNodes();
+    info.timeMs = elapsedMs();
+    info.pvLength = extractPV(best, info.pv, std::min(depth, MAX_PLY));
+    info.stats = stats;
+    info.stats.nodes = info.nodes;
+    info.stats.timeMs = info.timeMs;
+    infoCallback(info);
+}
+
+// Helpers have no budget of their own; they run until the main search
+// finishes and raises helperStop.
+void Search::runHelper(int threadIndex) {
+    resetCounters(SearchLimits());
+    iterativeDeepening(threadIndex);
+}
+
+// Searches every root move at `depth`, best-first, and returns the best
+// score from the side to move's point of view. Moves are searched with a
+// null window after the first unless every score has to be exact for the
+// noise; the loop stops early on a fail high.
+int Search::searchRoot(int depth, int alpha, int beta, int& searched) {
+    bool exactScores = limits.randomFactor > 0;
+    int bestScore = -INFINITE_SCORE;
+    MoveRecord record;
+    searched = 0;
+    
+    for (int i = 0; i < rootCount; i++) {
+        RootMove& root = rootMoves[i];
+        board.makeTemporaryMove(root.move, record);
+        ply++;
+        int score;
+        if (i == 0 || exactScores) {
+            score = -negamax(depth - 1, -beta, -alpha, true);
+        } else {
+            score = -negamax(depth - 1, -alpha - 1, -alpha, true);
+            if (score > alpha && score < beta) {
+                score = -negamax(depth - 1, -beta, -alpha, true);
+            }
+        }
+        ply--;
+        board.undoTemporaryMove(record);
+        
+        if (stopped) break;
+        root.score = score;
+        searched++;
+        bestScore = std::max(bestScore, score);
+        if (!exactScores && score > alpha) {
+            alpha = score;
+            if (alpha >= beta) break;
+        }
+    }
+    
+    // Best first, so the next search starts with the strongest line. A
+    // stable insertion sort: std::stable_sort may allocate a buffer.
+    for (int i = 1; i < searched; i++) {
+        RootMove root = rootMoves[i];
+        int j = i;
+        while (j > 0 && root.score > rootMoves[j - 1].score) {
+            rootMoves[j] = rootMoves[j - 1];
+            j--;
+        }
+        rootMoves[j] = root;
+    }
+    return bestScore;
+}
+
+Move Search::iterativeDeepening(int threadIndex) {
+    MoveList& moves = moveStack[0];
+    moves.clear();
+    generateMoves(board, moves);
+    rootCount = moves.count;
+    if (rootCount == 0) return Move();
+    for (int i = 0; i < rootCount; i++) {
+        rootMoves[i] = RootMove{moves.moves[i].move, 0, 0.0};
+    }
+    rootMaterial = materialCount();
+    if (bitbases) keepBitbaseMoves();
+    
+    // Try the previous search's choice first so it sets the bar early.
+    TTEntry entry;
+    if (tt->probe(board.getKey(), entry)) orderHashMove(rootCount, entry);
+    
+    // Helpers start from a different root move so the threads fill the
+    // table with different subtrees first.
+    if (threadIndex > 0) {
+        std::rotate(rootMoves, rootMoves + threadIndex % rootCount, rootMoves + rootCount);
+    }
+    
+    // Add randomness for easier difficulties
+    if (limits.randomFactor > 0) {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_real_distribution<> dis(-1.0, 1.0);
+        for (int i = 0; i < rootCount; i++) {
+            rootMoves[i].noise = dis(gen) * limits.randomFactor;
+        }
+    }
+    
+    int maxDepth = (limits.depth > 0) ? std::min(limits.depth, MAX_DEPTH) : MAX_DEPTH;
+    Move bestMove = rootMoves[0].move;
+    int previousScore = 0;
+    
+    // Every other helper runs one ply ahead of the main search.
+    for (int depth = 1 + (threadIndex & 1); depth <= maxDepth; depth++) {
+        // Expect this iteration to land near the last one; if it falls
+        // outside the window, widen that side and search again.
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -INFINITE_SCORE;
+        int beta = INFINITE_SCORE;
+        if (options.aspirationWindows && limits.randomFactor == 0 && depth >= ASPIRATION_MIN_DEPTH &&
+            !isMateScore(previousScore)) {
+            alpha = previousScore - delta;
+            beta = previousScore + delta;
+        }
+        
+        int score;
+        int searched;
+        while (true) {
+            score = searchRoot(depth, alpha, beta, searched);
+            if (stopped) break;
+            if (score <= alpha && alpha > -INFINITE_SCORE) {
+                alpha = std::max(score - delta, -INFINITE_SCORE);
+            } else if (score >= beta && beta < INFINITE_SCORE) {
+                beta = std::min(score + delta, INFINITE_SCORE);
+            } else {
+                break;
+            }
+            delta *= 2;
+        }
+        
+        // An unfinished iteration is only worth using if none finished.
+        if (stopped && (completedDepth > 0 || searched == 0)) break;
+        
+        // Add randomness for lower difficulties
+        double bestValue = -1e9;
+        for (int i = 0; i < searched; i++) {
+            double moveValue = rootMoves[i].score + rootMoves[i].noise;
+            if (moveValue > bestValue) {
+                bestValue = moveValue;
+                bestMove = rootMoves[i].move;
+            }
+        }
+        if (stopped) break;
+        
+        // The table only ever sees the noise-free result.
+        completedDepth = depth;
+        previousScore = rootMoves[0].score;
+        tt->store(board.getKey(), depth, BOUND_EXACT, scoreToTable(previousScore), rootMoves[0].move);
+        if (threadIndex == 0) {
+            int whiteScore = (board.getCurrentPlayer() == WHITE) ? previousScore : -previousScore;
+            stats.recordDepth(depth, whiteScore, getNodes(), elapsedMs());
+            reportIteration(depth, previousScore, rootMoves[0].move);
+        }
+        
+        if (isPondering()) continue;
+        // The next iteration takes several times longer than this one, so
+        // there is no point starting it with less than half the budget left.
+        if (limits.timeMs > 0 && elapsedMs() * 2 >= limits.timeMs) break;
+    }
+    
+    return bestMove;
+}
@@ -0,0 +1,239 @@
+#ifndef CHESS_ENGINE_SEARCH_H
+#define CHESS_ENGINE_SEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bitbase.h"
+#include "board.h"
+#include "book.h"
+#include "evaluate.h"
+#include "movegen.h"
+#include "moveorder.h"
+#include "nnue.h"
+#include "search_stats.h"
+#include "transposition.h"
+
+// Scores are centipawns. The search works from the side to move's point of
+// view; scores it hands out are from White's. Being checkmated
+// `ply` moves from the root scores MATE_SCORE - ply against the mated side,
+// so shorter mates score higher; anything within MAX_PLY of MATE_SCORE is a
+// mate score.
+const int INFINITE_SCORE = 32000;
+const int MATE_SCORE = 30000;
+
+// A position the bitbases call won scores this, plus the static evaluation
+// (held within BITBASE_EVAL_LIMIT) so the search still heads for the
+// simplest win, e.g. by promoting.
+const int BITBASE_WIN_SCORE = 20000;
+const int BITBASE_EVAL_LIMIT = 5000;
+
+inline bool isMateScore(int score) { return score >= MATE_SCORE - MAX_PLY || score <= -(MATE_SCORE - MAX_PLY); }
+
+// Full moves to mate for a mate score: positive when the side the score
+// belongs to mates, negative when it is mated.
+inline int mateInMoves(int score) { return (score > 0) ? (MATE_SCORE - score + 1) / 2 : -(MATE_SCORE + score) / 2; }
+
+// Budget for one getBestMove call. Zero means "no limit" for each field;
+// the search stops at whichever limit is reached first.
+struct SearchLimits {
+    int depth;            // plies, counting the root move
+    int timeMs;           // wall-clock budget
+    uint64_t nodes;
+    double randomFactor;  // up to this much noise on each root score
+    
+    SearchLimits() : depth(0), timeMs(0), nodes(0), randomFactor(0.0) {}
+    
+    static SearchLimits fixedDepth(int depth);
+    
+    // The window's Easy/Medium/Hard settings (aiDifficulty 1-3).
+    static SearchLimits forDifficulty(int aiDifficulty);
+};
+
+// Search features that can be switched off one at a time, to measure what
+// each is worth. All are on by default.
+struct SearchOptions {
+    bool aspirationWindows;
+    bool nullMove;
+    bool lateMoveReductions;
+    bool futilityPruning;
+    
+    SearchOptions() : aspirationWindows(true), nullMove(true), lateMoveReductions(true), futilityPruning(true) {}
+};
+
+// Progress after each completed iteration of the main search thread.
+struct SearchInfo {
+    int depth;
+    int score;  // from White's point of view
+    uint64_t nodes;  // summed over all threads
+    int timeMs;
+    Move pv[MAX_PLY];  // principal variation, read back from the hash table
+    int pvLength;
+    // Counters of the main thread so far; nodes and time cover all threads.
+    SearchStats stats;
+};
+
+// Principal variation search (negamax alpha-beta with null windows after
+// the first move) over a private copy of the board, so a search never
+// touches the position the caller is displaying. Move lists live in a
+// per-ply stack allocated with the Search, so searching does not touch the
+// heap.
+//
+// With more than one thread, getBestMove also runs helper searches (Lazy
+// SMP): each helper has its own board copy and move lists and searches the
+// same root with a different move order and depth. The helpers only talk
+// to the main search through the shared transposition table.
+class Search {
+public:
+    explicit Search(size_t hashMegabytes = 16);
+    explicit Search(std::shared_ptr<TranspositionTable> sharedTable);
+    
+    void setPosition(const Board& position);
+    const Board& getPosition() const { return board; }
+    
+    // Best move for the side to move. A position in the opening book is
+    // answered from the book without searching. Otherwise searches depth 1,
+    // 2, 3, ... until a limit is hit and returns the choice of the last
+    // completed iteration. Noise from randomFactor is drawn once per root
+    // move and added to its score, which is how the easier difficulties
+    // play weaker.
+    Move getBestMove(const SearchLimits& limits);
+    
+    // Book moves are picked at random, weighted by the book; null disables
+    // the book.
+    void setBook(std::shared_ptr<const OpeningBook> openingBook);
+    
+    // Evaluates with this network instead of the classical evaluation; null
+    // switches back. Helper threads use it too.
+    void setNetwork(std::shared_ptr<const nnue::Network> evalNetwork);
+    
+    // Win/draw/loss tables for small endings. Inside the tree they are
+    // probed once a capture or promotion leads into them; at the root only
+    // the moves that keep the tables' result are searched. Null switches
+    // them off.
+    void setBitbases(std::shared_ptr<const bitbase::Bitbases> tables);
+    
+    // Score from the side to move's point of view. `allowNull` is false
+    // right after a null move, so two never follow each other.
+    int negamax(int depth, int alpha, int beta, bool allowNull = true);
+    
+    // Searches captures only until the position is quiet, so the static
+    // evaluation is never taken in the middle of an exchange. The side to
+    // move may also stand pat on the static score, except in check, where
+    // every evasion is searched.
+    int quiescence(int alpha, int beta);
+    
+    void setOptions(const SearchOptions& searchOptions);
+    const SearchOptions& getOptions() const { return options; }
+    
+    // Nodes of the last search, summed over all its threads.
+    uint64_t getNodes() const;
+    // Counters of the last search, summed over all its threads; only
+    // complete once getBestMove has returned.
+    SearchStats getStats() const;
+    int getCompletedDepth() const { return completedDepth; }
+    
+    // The transposition table persists between searches; clear it when the
+    // game being analysed changes.
+    void setHashSize(size_t megabytes) { tt->resize(megabytes); }
+    void clearHash() { tt->clear(); }
+    
+    // Threads used by getBestMove, including the calling thread.
+    void setThreads(int count);
+    int getThreads() const { return int(helpers.size()) + 1; }
+    
+    // Another thread can end a running search early by setting this flag;
+    // getBestMove then returns its best move so far.
+    void setStopFlag(const std::atomic<bool>* flag) { stopFlag = flag; }
+    
+    // While this flag is set the search is pondering: it ignores its time
+    // and node limits, and does not return, until the flag is cleared (the
+    // predicted move was played) or the stop flag is raised. The limits then
+    // apply as if the search had started normally, so a reply already
+    // searched for long enough comes back at once. The depth limit always
+    // holds.
+    void setPonderFlag(const std::atomic<bool>* flag) { ponderFlag = flag; }
+    
+    // Called on the searching thread after every completed iteration.
+    void setInfoCallback(std::function<void(const SearchInfo&)> callback) { infoCallback = std::move(callback); }
+
+private:
+    struct RootMove {
+        Move move;
+        int score;
+        double noise;
+    };
+    
+    // Moves the table's best move for this position to the front.
+    void orderHashMove(int count, const TTEntry& entry);
+    
+    // The depth loop shared by the main search and its helpers; helper
+    // `threadIndex` (1, 2, ...) varies the root order and starting depth.
+    Move iterativeDeepening(int threadIndex);
+    int searchRoot(int depth, int alpha, int beta, int& searched);
+    void runHelper(int threadIndex);
+    
+    // Follows hash moves from the root, starting with `first`, while they
+    // are still playable; stops early on a repeated position.
+    int extractPV(Move first, Move* pv, int maxLength);
+    void reportIteration(int depth, int score, Move best);
+    void resetCounters(const SearchLimits& searchLimits);
+    
+    // Score of a node with no legal moves: mated at this ply, or a draw.
+    int mateOrStalemate() const;
+    // From the side to move's point of view; exact only inside
+    // [alpha, beta], see evaluateBoard. The network's score is always exact.
+    int staticEval(int alpha = -INFINITE_SCORE, int beta = INFINITE_SCORE);
+    bool hasNonPawnMaterial() const;
+    // Pieces on the board with pawns counted twice, so that captures and
+    // promotions both lower it.
+    int materialCount() const;
+    int bitbaseScore(bitbase::Result result);
+    // Drops the root moves that throw away a won or drawn result.
+    void keepBitbaseMoves();
+    int scoreToTable(int score) const;
+    int scoreFromTable(int score) const;
+    
+    // Counts a node and sets `stopped` once the node or time budget is spent.
+    void checkLimits();
+    bool isPondering() const { return ponderFlag && ponderFlag->load(std::memory_order_relaxed); }
+    int elapsedMs() const;
+    
+    Board board;
+    std::shared_ptr<TranspositionTable> tt;
+    OrderingTables ordering;
+    PawnHashTable pawnTable;
+    std::unique_ptr<MoveList[]> moveStack;  // indexed by ply
+    RootMove rootMoves[MAX_MOVES];
+    int rootCount;
+    int rootMaterial;  // materialCount() at the root
+    int ply;  // distance from the root of the node being searched
+    // Only this thread writes it; atomic so getNodes() can read it while
+    // the search runs.
+    std::atomic<uint64_t> nodes;
+    SearchStats stats;
+    
+    std::vector<std::unique_ptr<Search>> helpers;
+    std::atomic<bool> helperStop;
+    
+    SearchLimits limits;
+    SearchOptions options;
+    const std::atomic<bool>* stopFlag;
+    const std::atomic<bool>* ponderFlag;
+    std::function<void(const SearchInfo&)> infoCallback;
+    std::shared_ptr<const OpeningBook> book;
+    std::shared_ptr<const nnue::Network> network;
+    std::shared_ptr<const bitbase::Bitbases> bitbases;
+    std::mt19937_64 bookRandom;
+    std::chrono::steady_clock::time_point startTime;
+    bool stopped;
+    int completedDepth;
+};
+
+#endif
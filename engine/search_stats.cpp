@@ -0,0 +1,50 @@
+#include "search_stats.h"
+
+#include <cstdio>
+
+void SearchStats::clear() {
+    nodes = quiescenceNodes = 0;
+    ttProbes = ttHits = 0;
+    betaCutoffs = firstMoveCutoffs = 0;
+    timeMs = 0;
+    depthCount = 0;
+}
+
+void SearchStats::addCounters(const SearchStats& other) {
+    nodes += other.nodes;
+    quiescenceNodes += other.quiescenceNodes;
+    ttProbes += other.ttProbes;
+    ttHits += other.ttHits;
+    betaCutoffs += other.betaCutoffs;
+    firstMoveCutoffs += other.firstMoveCutoffs;
+}
+
+void SearchStats::recordDepth(int depth, int score, uint64_t totalNodes, int elapsedMs) {
+    if (depthCount >= MAX_DEPTH) return;
+    depths[depthCount++] = DepthStats{depth, score, totalNodes, elapsedMs};
+}
+
+std::string SearchStats::toJson() const {
+#ifdef CHESS_SEARCH_STATS
+    const char* enabled = "true";
+#else
+    const char* enabled = "false";
+#endif
+    char buffer[512];
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"counters\":%s,\"timeMs\":%d,\"nodes\":%llu,\"nps\":%llu,\"quiescenceNodes\":%llu,"
+                  "\"ttProbes\":%llu,\"ttHits\":%llu,\"betaCutoffs\":%llu,\"firstMoveCutoffs\":%llu,\"depths\":[",
+                  enabled, timeMs, (unsigned long long)nodes, (unsigned long long)nodesPerSecond(),
+                  (unsigned long long)quiescenceNodes, (unsigned long long)ttProbes, (unsigned long long)ttHits,
+                  (unsigned long long)betaCutoffs, (unsigned long long)firstMoveCutoffs);
+    std::string json = buffer;
+    
+    for (int i = 0; i < depthCount; i++) {
+        const DepthStats& entry = depths[i];
+        std::snprintf(buffer, sizeof(buffer), "%s{\"depth\":%d,\"score\":%d,\"nodes\":%llu,\"timeMs\":%d}",
+                      i > 0 ? "," : "", entry.depth, entry.score, (unsigned long long)entry.nodes, entry.timeMs);
+        json += buffer;
+    }
+    json += "]}";
+    return json;
+}
@@ -0,0 +1,58 @@
+#ifndef CHESS_ENGINE_SEARCH_STATS_H
+#define CHESS_ENGINE_SEARCH_STATS_H
+
+#include <cstdint>
+#include <string>
+
+// Deepest iteration the search runs.
+const int MAX_DEPTH = 64;
+
+// Counting on the search hot paths goes through SEARCH_STAT, which compiles
+// to nothing unless the engine is built with CHESS_SEARCH_STATS.
+#ifdef CHESS_SEARCH_STATS
+#define SEARCH_STAT(expr) (expr)
+#else
+#define SEARCH_STAT(expr) ((void)0)
+#endif
+
+// One completed iteration of the main search thread.
+struct DepthStats {
+    int depth;
+    int score;  // from White's point of view
+    uint64_t nodes;  // cumulative, summed over all threads
+    int timeMs;  // since the search started
+};
+
+// What one search did. Each Search owns its counters and is the only thread
+// writing them, so counting is a plain increment with no sharing between
+// threads; the totals of a multi-threaded search are summed once it is over.
+// Without CHESS_SEARCH_STATS only the node count, time and iterations are
+// filled in.
+struct SearchStats {
+    uint64_t nodes;  // every node, quiescence included
+    uint64_t quiescenceNodes;
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    uint64_t betaCutoffs;
+    uint64_t firstMoveCutoffs;  // cutoffs caused by the first move searched
+    int timeMs;
+    DepthStats depths[MAX_DEPTH];
+    int depthCount;
+    
+    SearchStats() { clear(); }
+    
+    void clear();
+    
+    // Adds another thread's counters; its iterations are not copied.
+    void addCounters(const SearchStats& other);
+    void recordDepth(int depth, int score, uint64_t totalNodes, int elapsedMs);
+    
+    uint64_t nodesPerSecond() const { return timeMs > 0 ? nodes * 1000 / timeMs : 0; }
+    double ttHitRate() const { return ttProbes > 0 ? double(ttHits) / ttProbes : 0.0; }
+    double firstMoveCutoffRate() const { return betaCutoffs > 0 ? double(firstMoveCutoffs) / betaCutoffs : 0.0; }
+    
+    // A single-line JSON object, for appending one search per line.
+    std::string toJson() const;
+};
+
+#endif
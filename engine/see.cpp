@@ -0,0 +1,84 @@
+#include "see.h"
+
+#include <algorithm>
+
+#include "evaluate.h"
+#include "movegen.h"
+
+namespace {
+
+// Cheapest first, which is not the PieceType order.
+const PieceType byValue[6] = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING};
+
+// Finds `color`'s least valuable piece among `attackers`, setting its
+// square and type. Returns false if `color` has none.
+bool leastValuableAttacker(const BitboardPosition& bitboards, Bitboard attackers, PieceColor color,
+                           int& square, PieceType& type) {
+    for (PieceType candidate : byValue) {
+        Bitboard subset = attackers & bitboards.pieces[color][candidate];
+        if (subset) {
+            square = lsb(subset);
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+int staticExchange(const Board& board, Move move) {
+    const BitboardPosition& bitboards = board.getBitboards();
+    int target = move.to();
+    int from = move.from();
+    PieceColor side = board.pieceAt(from).color;
+    PieceType attacker = board.pieceAt(from).type;
+    
+    Bitboard sliders = bitboards.pieces[WHITE][ROOK] | bitboards.pieces[BLACK][ROOK] |
+                       bitboards.pieces[WHITE][BISHOP] | bitboards.pieces[BLACK][BISHOP] |
+                       bitboards.pieces[WHITE][QUEEN] | bitboards.pieces[BLACK][QUEEN];
+    Bitboard occupied = bitboards.occupied;
+    
+    // gain[d] is the balance for the side making capture d if the exchange
+    // stopped right after it.
+    int gain[32];
+    int d = 0;
+    gain[0] = pieceValues[board.pieceAt(target).type];
+    if (move.flag() == EN_PASSANT) {
+        // The pawn taken is beside the target square, which is empty.
+        occupied ^= squareBB((from & ~7) | (target & 7));
+        gain[0] = pieceValues[PAWN];
+    } else if (move.flag() == PROMOTION) {
+        // The pawn arrives as the new piece, and that is what is put at risk.
+        gain[0] += pieceValues[move.promotion()] - pieceValues[PAWN];
+        attacker = move.promotion();
+    }
+    Bitboard attackers = attackersTo(board, target, occupied);
+    
+    while (true) {
+        d++;
+        gain[d] = pieceValues[attacker] - gain[d - 1];
+        // Neither side can do better by continuing.
+        if (std::max(-gain[d - 1], gain[d]) < 0) break;
+        
+        // Taking any piece off the board can uncover a slider behind it,
+        // pawns included. A knight never stands on a line through the
+        // target, and a king only captures when nothing can take back. The
+        // board still holds the piece that started on `from`, a pawn for a
+        // promotion.
+        occupied ^= squareBB(from);
+        PieceType moved = board.pieceAt(from).type;
+        if (moved != KNIGHT && moved != KING) {
+            attackers |= attackersTo(board, target, occupied) & sliders;
+        }
+        attackers &= occupied;
+        
+        side = opponent(side);
+        if (d == 31 || !leastValuableAttacker(bitboards, attackers, side, from, attacker)) break;
+    }
+    
+    while (--d) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    }
+    return gain[0];
+}
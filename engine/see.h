@@ -0,0 +1,12 @@
+#ifndef CHESS_ENGINE_SEE_H
+#define CHESS_ENGINE_SEE_H
+
+#include "board.h"
+
+// Static exchange evaluation: the material the side making `move` wins or
+// loses, in centipawns, if both sides keep recapturing on the target square
+// with their least valuable attacker and may stop whenever that is better.
+// Pieces behind a capturer (x-rays) join in as the squares clear.
+int staticExchange(const Board& board, Move move);
+
+#endif
@@ -0,0 +1,101 @@
+#include "transposition.h"
+
+// Layout of Slot::data, low bits first:
+//   0-15  score (int16)      16-23 depth       24-25 bound
+//   26-41 best move (Move::raw, 0 when none)
+//   42-49 generation
+
+bool TranspositionTable::Slot::load(uint64_t key, uint64_t& out) const {
+    uint64_t value = data.load(std::memory_order_relaxed);
+    if (value == 0 || (check.load(std::memory_order_relaxed) ^ value) != key) return false;
+    out = value;
+    return true;
+}
+
+void TranspositionTable::Slot::save(uint64_t key, uint64_t value) {
+    check.store(key ^ value, std::memory_order_relaxed);
+    data.store(value, std::memory_order_relaxed);
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes) : bucketCount(0), mask(0), generation(0) {
+    resize(megabytes);
+}
+
+void TranspositionTable::resize(size_t megabytes) {
+    size_t budget = (megabytes > 0 ? megabytes : 1) * 1024 * 1024;
+    size_t count = 1;
+    while (count * 2 * sizeof(Bucket) <= budget) {
+        count *= 2;
+    }
+    
+    buckets.reset(new Bucket[count]);
+    bucketCount = count;
+    mask = count - 1;
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i < bucketCount; i++) {
+        buckets[i].deepest.save(0, 0);
+        buckets[i].recent.save(0, 0);
+    }
+    generation.store(0);
+}
+
+uint64_t TranspositionTable::pack(int depth, BoundType bound, int score, Move bestMove,
+                                  unsigned generation) {
+    uint64_t data = uint64_t(uint16_t(int16_t(score)));
+    data |= uint64_t(depth & 0xFF) << 16;
+    data |= uint64_t(bound & 0x3) << 24;
+    data |= uint64_t(bestMove.raw()) << 26;
+    data |= uint64_t(generation & 0xFF) << 42;
+    return data;
+}
+
+TTEntry TranspositionTable::unpack(uint64_t key, uint64_t data) {
+    TTEntry entry;
+    entry.key = key;
+    entry.score = int16_t(uint16_t(data & 0xFFFF));
+    entry.depth = slotDepth(data);
+    entry.bound = BoundType((data >> 24) & 0x3);
+    entry.bestMove = Move::fromRaw(uint16_t((data >> 26) & 0xFFFF));
+    return entry;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const {
+    const Bucket& bucket = buckets[key & mask];
+    uint64_t data;
+    if (bucket.deepest.load(key, data) || bucket.recent.load(key, data)) {
+        entry = unpack(key, data);
+        return true;
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, BoundType bound, int score, Move bestMove) {
+    Bucket& bucket = buckets[key & mask];
+    Move move = bestMove;
+    
+    // Keep the previous best move when re-storing a position without one.
+    if (move.isNull()) {
+        TTEntry previous;
+        if (probe(key, previous)) move = previous.bestMove;
+    }
+    unsigned currentGeneration = generation.load(std::memory_order_relaxed);
+    uint64_t data = pack(depth, bound, score, move, currentGeneration);
+    
+    uint64_t deepestData = bucket.deepest.data.load(std::memory_order_relaxed);
+    uint64_t deepestKey = bucket.deepest.check.load(std::memory_order_relaxed) ^ deepestData;
+    
+    if (deepestKey == key || deepestData == 0 ||
+        slotGeneration(deepestData) != currentGeneration ||
+        depth >= slotDepth(deepestData)) {
+        // The displaced entry still gets a second life in the recent slot.
+        if (deepestKey != key && deepestData != 0) {
+            bucket.recent.save(deepestKey, deepestData);
+        }
+        bucket.deepest.save(key, data);
+    } else {
+        bucket.recent.save(key, data);
+    }
+}
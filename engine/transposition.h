@@ -0,0 +1,76 @@
+#ifndef CHESS_ENGINE_TRANSPOSITION_H
+#define CHESS_ENGINE_TRANSPOSITION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "types.h"
+
+enum BoundType {
+    BOUND_NONE = 0,
+    BOUND_EXACT = 1,
+    BOUND_LOWER = 2,  // score is at least this (failed high)
+    BOUND_UPPER = 3   // score is at most this (failed low)
+};
+
+struct TTEntry {
+    uint64_t key;
+    int score;
+    int depth;
+    BoundType bound;
+    Move bestMove;  // null when no move is known
+};
+
+// Fixed-size hash of searched positions, sized by a memory budget. Each
+// bucket holds two slots: one keeps the deepest result seen for its index,
+// the other always takes the most recent store.
+//
+// Several search threads may probe and store at once without locking. A
+// slot keeps its key XORed with its data word, so a slot torn by two racing
+// writers fails the key check on probe and reads as a miss.
+class TranspositionTable {
+public:
+    explicit TranspositionTable(size_t megabytes = 16);
+    
+    // Reallocates to the largest power-of-two bucket count that fits in
+    // `megabytes`, discarding all entries.
+    void resize(size_t megabytes);
+    void clear();
+    
+    // Marks the start of a new search so entries left by older searches are
+    // replaced before fresher ones.
+    void newSearch() { generation.store((generation.load() + 1) & 0xFF); }
+    
+    bool probe(uint64_t key, TTEntry& entry) const;
+    void store(uint64_t key, int depth, BoundType bound, int score, Move bestMove);
+    
+    size_t getSizeBytes() const { return bucketCount * sizeof(Bucket); }
+
+private:
+    // Score, depth, bound, best move and generation packed into one word.
+    struct Slot {
+        std::atomic<uint64_t> check;  // key ^ data
+        std::atomic<uint64_t> data;
+        
+        bool load(uint64_t key, uint64_t& out) const;
+        void save(uint64_t key, uint64_t value);
+    };
+    struct Bucket {
+        Slot deepest;
+        Slot recent;
+    };
+    
+    static uint64_t pack(int depth, BoundType bound, int score, Move bestMove, unsigned generation);
+    static TTEntry unpack(uint64_t key, uint64_t data);
+    static int slotDepth(uint64_t data) { return int((data >> 16) & 0xFF); }
+    static unsigned slotGeneration(uint64_t data) { return unsigned((data >> 42) & 0xFF); }
+    
+    std::unique_ptr<Bucket[]> buckets;
+    size_t bucketCount;
+    uint64_t mask;
+    std::atomic<unsigned> generation;
+};
+
+#endif
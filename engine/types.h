@@ -0,0 +1,102 @@
+#ifndef CHESS_ENGINE_TYPES_H
+#define CHESS_ENGINE_TYPES_H
+
+#include <cstdint>
+
+enum PieceType {
+    EMPTY = 0,
+    PAWN = 1,
+    ROOK = 2,
+    KNIGHT = 3,
+    BISHOP = 4,
+    QUEEN = 5,
+    KING = 6
+};
+
+enum PieceColor {
+    NONE = 0,
+    WHITE = 1,
+    BLACK = 2
+};
+
+inline PieceColor opponent(PieceColor color) {
+    return (color == WHITE) ? BLACK : WHITE;
+}
+
+struct Piece {
+    PieceType type;
+    PieceColor color;
+    
+    Piece() : type(EMPTY), color(NONE) {}
+    Piece(PieceType t, PieceColor c) : type(t), color(c) {}
+};
+
+struct Position {
+    int row, col;
+    Position(int r = -1, int c = -1) : row(r), col(c) {}
+    bool operator==(const Position& other) const {
+        return row == other.row && col == other.col;
+    }
+};
+
+enum CastlingRight {
+    WHITE_KINGSIDE = 1,
+    WHITE_QUEENSIDE = 2,
+    BLACK_KINGSIDE = 4,
+    BLACK_QUEENSIDE = 8,
+    ALL_CASTLING = 15
+};
+
+enum MoveFlag {
+    NORMAL_MOVE = 0,
+    PROMOTION = 1,
+    EN_PASSANT = 2,
+    CASTLING = 3
+};
+
+// A move packed into 16 bits. Squares are numbered row * 8 + col:
+//   bits 0-5   from square
+//   bits 6-11  to square
+//   bits 12-13 promotion piece, counted from ROOK (ROOK, KNIGHT, BISHOP, QUEEN)
+//   bits 14-15 MoveFlag
+// Castling is stored as the king's two-square move, e.g. e1g1.
+// The moving and captured pieces are not stored; they are read from the
+// board, or from the MoveRecord once the move has been made. The all-zero
+// value (a8 to a8) is never a real move and serves as "no move".
+class Move {
+public:
+    Move() : data(0) {}
+    Move(int from, int to, MoveFlag flag = NORMAL_MOVE, PieceType promotion = ROOK)
+        : data(uint16_t(from | (to << 6) | ((promotion - ROOK) << 12) | (flag << 14))) {}
+    
+    int from() const { return data & 0x3F; }
+    int to() const { return (data >> 6) & 0x3F; }
+    MoveFlag flag() const { return MoveFlag(data >> 14); }
+    PieceType promotion() const { return PieceType(ROOK + ((data >> 12) & 0x3)); }
+    
+    bool isNull() const { return data == 0; }
+    uint16_t raw() const { return data; }
+    static Move fromRaw(uint16_t raw) { Move move; move.data = raw; return move; }
+    
+    bool operator==(const Move& other) const { return data == other.data; }
+    bool operator!=(const Move& other) const { return data != other.data; }
+
+private:
+    uint16_t data;
+};
+
+// What making a move changed, so it can be taken back and shown in the
+// move history.
+struct MoveRecord {
+    Move move;
+    Piece piece;     // the piece that moved
+    Piece captured;  // EMPTY when nothing was taken; the pawn for en passant
+    
+    // State before the move, restored by undo.
+    uint64_t key;
+    int castlingRights;
+    int enPassantSquare;
+    int halfmoveClock;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "zobrist.h"
+
+const ZobristKeys zobrist;
+
+namespace {
+
+// SplitMix64: small, fast and well distributed, which is all the keys need.
+uint64_t nextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+}
+
+ZobristKeys::ZobristKeys() {
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (int c = 0; c < 3; c++) {
+        for (int t = 0; t < 7; t++) {
+            for (int square = 0; square < 64; square++) {
+                pieces[c][t][square] = nextRandom(state);
+            }
+        }
+    }
+    side = nextRandom(state);
+    for (int rights = 0; rights < 16; rights++) {
+        castling[rights] = rights ? nextRandom(state) : 0;
+    }
+    for (int file = 0; file < 8; file++) {
+        enPassant[file] = nextRandom(state);
+    }
+}
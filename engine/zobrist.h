@@ -0,0 +1,20 @@
+#ifndef CHESS_ENGINE_ZOBRIST_H
+#define CHESS_ENGINE_ZOBRIST_H
+
+#include <cstdint>
+
+// Random keys XORed together to identify a position. The generator is
+// seeded with a constant so keys, and anything stored under them, are the
+// same on every run.
+struct ZobristKeys {
+    uint64_t pieces[3][7][64];  // [color][type][square]
+    uint64_t side;              // XORed in when Black is to move
+    uint64_t castling[16];      // [CastlingRight bits]
+    uint64_t enPassant[8];      // [file], only while a capture is possible
+
+    ZobristKeys();
+};
+
+extern const ZobristKeys zobrist;
+
+#endif
@@ -3,61 +3,41 @@
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <random>
-#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
 
-enum PieceType {
-    EMPTY = 0,
-    PAWN = 1,
-    ROOK = 2,
-    KNIGHT = 3,
-    BISHOP = 4,
-    QUEEN = 5,
-    KING = 6
-};
-
-enum PieceColor {
-    NONE = 0,
-    WHITE = 1,
-    BLACK = 2
-};
+#include "engine/archive.h"
+#include "engine/async_search.h"
+#include "engine/board.h"
+#include "engine/movegen.h"
 
 enum GameMode {
     LOCAL_MULTIPLAYER = 0,
     VS_AI = 1
 };
 
-struct Piece {
-    PieceType type;
-    PieceColor color;
-    
-    Piece() : type(EMPTY), color(NONE) {}
-    Piece(PieceType t, PieceColor c) : type(t), color(c) {}
-};
+// Pieces are drawn as letters rendered once into a texture atlas, one
+// SQUARE_SIZE cell per piece: White on the top row, Black below, in
+// PieceType order from PAWN.
+const int SQUARE_SIZE = 100;
+const int HISTORY_LINES = 10;
+const int STATS_LINES = 5;
+// While the AI thinks there are no input events to wake the loop, so it
+// checks for the finished move this often instead.
+const int AI_POLL_MS = 15;
+// Every game played in the window is appended here.
+const char* const GAME_ARCHIVE = "games.bin";
 
-struct Position {
-    int row, col;
-    Position(int r = -1, int c = -1) : row(r), col(c) {}
-    bool operator==(const Position& other) const {
-        return row == other.row && col == other.col;
-    }
-};
-
-struct Move {
-    Position from, to;
-    Piece piece;
-    Piece captured;
-    int score;
-    
-    Move() : score(0) {}
-    Move(Position f, Position t, Piece p, Piece c = Piece()) 
-        : from(f), to(t), piece(p), captured(c), score(0) {}
+struct Button {
+    sf::RectangleShape shape;
+    sf::Text label;
 };
 
 class ChessGame {
 private:
-    Piece board[8][8];
-    PieceColor currentPlayer;
+    Board board;
+    AsyncSearch ai;
     Position selectedSquare;
     bool pieceSelected;
     sf::RenderWindow window;
@@ -65,277 +45,72 @@ private:
     GameMode gameMode;
     int aiDifficulty; // 1-3 (Easy, Medium, Hard)
     bool isAIThinking;
-    std::vector<Move> moveHistory;
+    // While the human thinks, the AI searches its answer to the reply it
+    // expects; `ponderMove` is that reply.
+    bool isAIPondering;
+    Move ponderMove;
+    // Set once the game is in the archive, so it is stored only once.
+    bool gameArchived;
+    
+    // Retained drawing state. The geometry and text below only change in
+    // refresh(), which runs when `dirty` is set; every other frame just
+    // draws them again.
+    bool dirty;
+    sf::VertexArray boardVertices;
+    sf::VertexArray highlightVertices;
+    sf::VertexArray pieceVertices;
+    sf::RenderTexture pieceAtlas;
+    sf::Text statusText;
+    sf::Text difficultyTitle;
+    sf::Text historyTitle;
+    sf::Text historyLines[HISTORY_LINES];
+    int historyLineCount;
+    sf::Text statsTitle;
+    sf::Text statsLines[STATS_LINES];
+    
+    // The AI's search as it runs, then its final totals.
+    SearchStats aiStats;
+    Button newGameButton, undoButton, localButton, aiButton;
+    Button easyButton, mediumButton, hardButton;
     
     // Colors
     sf::Color lightSquare = sf::Color(240, 217, 181);
     sf::Color darkSquare = sf::Color(181, 136, 99);
     sf::Color selectedColor = sf::Color(255, 255, 0, 128);
     sf::Color lastMoveColor = sf::Color(0, 255, 0, 100);
-    
-    // Piece values for AI evaluation
-    int pieceValues[7] = {0, 1, 5, 3, 3, 9, 1000}; // EMPTY, PAWN, ROOK, KNIGHT, BISHOP, QUEEN, KING
 
 public:
-    ChessGame() : currentPlayer(WHITE), selectedSquare(-1, -1), pieceSelected(false),
+    ChessGame() : selectedSquare(-1, -1), pieceSelected(false),
                   window(sf::VideoMode(1200, 800), "Enhanced Chess Game"),
-                  gameMode(LOCAL_MULTIPLAYER), aiDifficulty(2), isAIThinking(false) {
-        initializeBoard();
+                  gameMode(LOCAL_MULTIPLAYER), aiDifficulty(2), isAIThinking(false), isAIPondering(false),
+                  gameArchived(false), dirty(true),
+                  boardVertices(sf::Quads, 64 * 4), highlightVertices(sf::Quads),
+                  pieceVertices(sf::Quads), historyLineCount(0) {
+        window.setFramerateLimit(60);
+        // Leave one core for the window.
+        ai.setThreads(std::max(1, (int)std::thread::hardware_concurrency() - 1));
         if (!font.loadFromFile("arial.ttf")) {
             std::cout << "Warning: Could not load font file. Using default font." << std::endl;
         }
-    }
-    
-    void initializeBoard() {
-        // Clear board
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 8; j++) {
-                board[i][j] = Piece();
-            }
-        }
-        
-        // Place pawns
-        for (int j = 0; j < 8; j++) {
-            board[1][j] = Piece(PAWN, BLACK);
-            board[6][j] = Piece(PAWN, WHITE);
-        }
-        
-        // Place other pieces
-        PieceType backRow[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
-        
-        for (int j = 0; j < 8; j++) {
-            board[0][j] = Piece(backRow[j], BLACK);
-            board[7][j] = Piece(backRow[j], WHITE);
-        }
-    }
-    
-    bool isValidMove(int fromRow, int fromCol, int toRow, int toCol) {
-        if (toRow < 0 || toRow >= 8 || toCol < 0 || toCol >= 8) return false;
-        
-        Piece fromPiece = board[fromRow][fromCol];
-        Piece toPiece = board[toRow][toCol];
-        
-        if (toPiece.color == fromPiece.color) return false;
-        if (fromPiece.type == EMPTY) return false;
-        
-        int rowDiff = toRow - fromRow;
-        int colDiff = toCol - fromCol;
-        
-        switch (fromPiece.type) {
-            case PAWN: {
-                int direction = (fromPiece.color == WHITE) ? -1 : 1;
-                
-                if (colDiff == 0) {
-                    if (rowDiff == direction && toPiece.type == EMPTY) return true;
-                    if (rowDiff == 2 * direction && toPiece.type == EMPTY && 
-                        ((fromPiece.color == WHITE && fromRow == 6) || 
-                         (fromPiece.color == BLACK && fromRow == 1))) return true;
-                }
-                else if (abs(colDiff) == 1 && rowDiff == direction && toPiece.type != EMPTY) {
-                    return true;
-                }
-                return false;
-            }
-            
-            case ROOK:
-                if (rowDiff == 0 || colDiff == 0) {
-                    return isPathClear(fromRow, fromCol, toRow, toCol);
-                }
-                return false;
-                
-            case BISHOP:
-                if (abs(rowDiff) == abs(colDiff)) {
-                    return isPathClear(fromRow, fromCol, toRow, toCol);
-                }
-                return false;
-                
-            case QUEEN:
-                if (rowDiff == 0 || colDiff == 0 || abs(rowDiff) == abs(colDiff)) {
-                    return isPathClear(fromRow, fromCol, toRow, toCol);
-                }
-                return false;
-                
-            case KING:
-                return abs(rowDiff) <= 1 && abs(colDiff) <= 1;
-                
-            case KNIGHT:
-                return (abs(rowDiff) == 2 && abs(colDiff) == 1) || 
-                       (abs(rowDiff) == 1 && abs(colDiff) == 2);
-                
-            default:
-                return false;
-        }
-    }
-    
-    bool isPathClear(int fromRow, int fromCol, int toRow, int toCol) {
-        int rowStep = (toRow > fromRow) ? 1 : (toRow < fromRow) ? -1 : 0;
-        int colStep = (toCol > fromCol) ? 1 : (toCol < fromCol) ? -1 : 0;
-        
-        int currentRow = fromRow + rowStep;
-        int currentCol = fromCol + colStep;
-        
-        while (currentRow != toRow || currentCol != toCol) {
-            if (board[currentRow][currentCol].type != EMPTY) return false;
-            currentRow += rowStep;
-            currentCol += colStep;
-        }
-        
-        return true;
-    }
-    
-    std::vector<Move> getAllValidMoves(PieceColor color) {
-        std::vector<Move> moves;
-        
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                if (board[row][col].color == color && board[row][col].type != EMPTY) {
-                    for (int toRow = 0; toRow < 8; toRow++) {
-                        for (int toCol = 0; toCol < 8; toCol++) {
-                            if (isValidMove(row, col, toRow, toCol)) {
-                                Move move(Position(row, col), Position(toRow, toCol), 
-                                         board[row][col], board[toRow][toCol]);
-                                moves.push_back(move);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        
-        return moves;
-    }
-    
-    int evaluateBoard() {
-        int score = 0;
-        
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                Piece piece = board[row][col];
-                if (piece.type != EMPTY) {
-                    int value = pieceValues[piece.type];
-                    
-                    // Add positional bonuses
-                    if (piece.type == PAWN) {
-                        value += (piece.color == WHITE) ? (6 - row) : (row - 1);
-                    } else if (piece.type == KNIGHT || piece.type == BISHOP) {
-                        // Encourage central positions
-                        int centerDistance = abs(3.5 - row) + abs(3.5 - col);
-                        value += (7 - centerDistance);
-                    }
-                    
-                    score += (piece.color == WHITE) ? value : -value;
-                }
-            }
-        }
-        
-        return score;
-    }
-    
-    int minimax(int depth, bool isMaximizing, int alpha = -10000, int beta = 10000) {
-        if (depth == 0) {
-            return evaluateBoard();
+        // The opening book is optional; without it the AI searches every move.
+        std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>();
+        if (book->open("book.bin")) {
+            ai.setBook(book);
         }
-        
-        PieceColor color = isMaximizing ? WHITE : BLACK;
-        std::vector<Move> moves = getAllValidMoves(color);
-        
-        if (moves.empty()) {
-            return isMaximizing ? -1000 : 1000;
+        // Likewise the network: the classical evaluation is used without it.
+        std::shared_ptr<nnue::Network> network = std::make_shared<nnue::Network>();
+        if (network->open("network.nnue")) {
+            ai.setNetwork(network);
         }
-        
-        if (isMaximizing) {
-            int maxEval = -10000;
-            for (const Move& move : moves) {
-                makeTemporaryMove(move);
-                int eval = minimax(depth - 1, false, alpha, beta);
-                undoTemporaryMove(move);
-                
-                maxEval = std::max(maxEval, eval);
-                alpha = std::max(alpha, eval);
-                
-                if (beta <= alpha) break; // Alpha-beta pruning
-            }
-            return maxEval;
-        } else {
-            int minEval = 10000;
-            for (const Move& move : moves) {
-                makeTemporaryMove(move);
-                int eval = minimax(depth - 1, true, alpha, beta);
-                undoTemporaryMove(move);
-                
-                minEval = std::min(minEval, eval);
-                beta = std::min(beta, eval);
-                
-                if (beta <= alpha) break; // Alpha-beta pruning
-            }
-            return minEval;
-        }
-    }
-    
-    void makeTemporaryMove(const Move& move) {
-        board[move.to.row][move.to.col] = board[move.from.row][move.from.col];
-        board[move.from.row][move.from.col] = Piece();
-    }
-    
-    void undoTemporaryMove(const Move& move) {
-        board[move.from.row][move.from.col] = move.piece;
-        board[move.to.row][move.to.col] = move.captured;
-    }
-    
-    Move getBestMove() {
-        std::vector<Move> moves = getAllValidMoves(BLACK);
-        if (moves.empty()) return Move();
-        
-        Move bestMove = moves[0];
-        int bestValue = 10000;
-        
-        // Add randomness for easier difficulties
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dis(-1.0, 1.0);
-        
-        double randomFactor = (3.0 - aiDifficulty) * 50.0;
-        
-        for (Move& move : moves) {
-            makeTemporaryMove(move);
-            int moveValue = minimax(aiDifficulty, true);
-            undoTemporaryMove(move);
-            
-            // Add randomness for lower difficulties
-            if (randomFactor > 0) {
-                moveValue += dis(gen) * randomFactor;
-            }
-            
-            if (moveValue < bestValue) {
-                bestValue = moveValue;
-                bestMove = move;
-            }
+        // And the endgame bitbases, which only make the AI play small endings exactly.
+        std::shared_ptr<bitbase::Bitbases> bitbases = std::make_shared<bitbase::Bitbases>();
+        if (bitbases->open("bitbases.bin")) {
+            ai.setBitbases(bitbases);
         }
         
-        return bestMove;
-    }
-    
-    void makeMove(int fromRow, int fromCol, int toRow, int toCol) {
-        Move move(Position(fromRow, fromCol), Position(toRow, toCol), 
-                 board[fromRow][fromCol], board[toRow][toCol]);
-        
-        board[toRow][toCol] = board[fromRow][fromCol];
-        board[fromRow][fromCol] = Piece();
-        
-        moveHistory.push_back(move);
-        currentPlayer = (currentPlayer == WHITE) ? BLACK : WHITE;
-    }
-    
-    void undoLastMove() {
-        if (moveHistory.empty()) return;
-        
-        Move lastMove = moveHistory.back();
-        moveHistory.pop_back();
-        
-        board[lastMove.from.row][lastMove.from.col] = lastMove.piece;
-        board[lastMove.to.row][lastMove.to.col] = lastMove.captured;
-        
-        currentPlayer = (currentPlayer == WHITE) ? BLACK : WHITE;
+        buildBoard();
+        buildPieceAtlas();
+        buildUI();
     }
     
     std::string getPieceSymbol(const Piece& piece) {
@@ -352,7 +127,7 @@ public:
             return;
         }
         
-        if (isAIThinking || (gameMode == VS_AI && currentPlayer == BLACK)) return;
+        if (isAIThinking || (gameMode == VS_AI && board.getCurrentPlayer() == BLACK)) return;
         
         int col = mouseX / 100;
         int row = mouseY / 100;
@@ -360,7 +135,7 @@ public:
         if (row < 0 || row >= 8 || col < 0 || col >= 8) return;
         
         if (!pieceSelected) {
-            if (board[row][col].type != EMPTY && board[row][col].color == currentPlayer) {
+            if (board.pieceAt(row, col).type != EMPTY && board.pieceAt(row, col).color == board.getCurrentPlayer()) {
                 selectedSquare = Position(row, col);
                 pieceSelected = true;
             }
@@ -368,12 +143,12 @@ public:
             if (selectedSquare.row == row && selectedSquare.col == col) {
                 pieceSelected = false;
                 selectedSquare = Position(-1, -1);
-            } else if (isValidMove(selectedSquare.row, selectedSquare.col, row, col)) {
-                makeMove(selectedSquare.row, selectedSquare.col, row, col);
+            } else if (isValidMove(board, selectedSquare.row, selectedSquare.col, row, col)) {
+                board.makeMove(selectedSquare.row, selectedSquare.col, row, col);
                 pieceSelected = false;
                 selectedSquare = Position(-1, -1);
             } else {
-                if (board[row][col].type != EMPTY && board[row][col].color == currentPlayer) {
+                if (board.pieceAt(row, col).type != EMPTY && board.pieceAt(row, col).color == board.getCurrentPlayer()) {
                     selectedSquare = Position(row, col);
                 } else {
                     pieceSelected = false;
@@ -390,7 +165,8 @@ public:
         }
         // Undo Move button
         else if (mouseX >= 820 && mouseX <= 920 && mouseY >= 100 && mouseY <= 140) {
-            undoLastMove();
+            cancelAIMove();
+            board.undoLastMove();
         }
         // Local Multiplayer button
         else if (mouseX >= 820 && mouseX <= 980 && mouseY >= 200 && mouseY <= 240) {
@@ -404,6 +180,7 @@ public:
         }
         // AI Difficulty buttons
         else if (gameMode == VS_AI) {
+            int previousDifficulty = aiDifficulty;
             if (mouseX >= 820 && mouseX <= 870 && mouseY >= 320 && mouseY <= 360) {
                 aiDifficulty = 1; // Easy
             }
@@ -413,218 +190,410 @@ public:
             else if (mouseX >= 940 && mouseX <= 990 && mouseY >= 320 && mouseY <= 360) {
                 aiDifficulty = 3; // Hard
             }
+            // A ponder runs with the old difficulty's limits.
+            if (isAIPondering && aiDifficulty != previousDifficulty) cancelAIMove();
         }
     }
     
     void resetGame() {
-        initializeBoard();
-        currentPlayer = WHITE;
+        cancelAIMove();
+        archiveGame(UNFINISHED);
+        gameArchived = false;
+        ai.clearHash();
+        board.initializeBoard();
         selectedSquare = Position(-1, -1);
         pieceSelected = false;
-        isAIThinking = false;
-        moveHistory.clear();
+        aiStats.clear();
     }
     
+    // Stores the game unless it is already stored or no move was played.
+    void archiveGame(GameOutcome outcome) {
+        if (gameArchived || board.getMoveHistory().empty()) return;
+        
+        if (!GameArchive::append(GAME_ARCHIVE, board, outcome)) {
+            std::cout << "Warning: Could not save the game to " << GAME_ARCHIVE << std::endl;
+        }
+        gameArchived = true;
+    }
+    
+    // Archives the game with its result once there are no legal moves.
+    void archiveIfOver() {
+        if (gameArchived || isAIThinking || !getAllValidMoves(board).empty()) return;
+        
+        GameOutcome outcome = DRAWN;
+        if (isInCheck(board)) {
+            outcome = (board.getCurrentPlayer() == WHITE) ? BLACK_WINS : WHITE_WINS;
+        }
+        archiveGame(outcome);
+    }
+    
+    // Starts the search on the worker thread; finishAIMove plays its move
+    // once it is ready. If the AI has been pondering the move just played,
+    // that search simply goes on.
     void makeAIMove() {
-        if (gameMode != VS_AI || currentPlayer != BLACK || isAIThinking) return;
+        if (gameMode != VS_AI || board.getCurrentPlayer() != BLACK || isAIThinking) return;
+        if (getAllValidMoves(board).empty()) {
+            // The human's move ended the game; a ponder search would
+            // otherwise run on until New Game.
+            if (isAIPondering) cancelAIMove();
+            return;
+        }
         
         isAIThinking = true;
-        Move bestMove = getBestMove();
+        dirty = true;
+        if (isAIPondering) {
+            isAIPondering = false;
+            const std::vector<MoveRecord>& history = board.getMoveHistory();
+            if (!history.empty() && history.back().move == ponderMove) {
+                ai.ponderHit();
+                return;
+            }
+        }
+        // A wrong guess still leaves its positions in the hash table.
+        ai.start(board, SearchLimits::forDifficulty(aiDifficulty));
+    }
+    
+    // Searches the position after the reply the AI's last search expects,
+    // on the human's time.
+    void startPondering() {
+        Move reply = ai.getExpectedReply();
+        if (reply.isNull() || !isLegalMove(board, reply)) return;
+        
+        Board expected = board;
+        expected.makeMove(reply);
+        if (getAllValidMoves(expected).empty()) return;
+        
+        ponderMove = reply;
+        isAIPondering = true;
+        ai.ponder(expected, SearchLimits::forDifficulty(aiDifficulty));
+    }
+    
+    void finishAIMove() {
+        Move bestMove;
+        if (!isAIThinking || !ai.takeResult(bestMove)) return;
         
-        if (bestMove.from.row != -1) {
-            makeMove(bestMove.from.row, bestMove.from.col, bestMove.to.row, bestMove.to.col);
+        if (!bestMove.isNull()) {
+            board.makeMove(bestMove);
         }
         
+        // Helper threads only add their counters once the search is over.
+        aiStats = ai.getStats();
         isAIThinking = false;
+        dirty = true;
+        startPondering();
     }
     
-    void draw() {
-        window.clear(sf::Color::White);
-        
-        // Draw board
+    // Shows each completed iteration while the AI is still thinking.
+    void pollAIProgress() {
+        SearchInfo info;
+        if (isAIThinking && ai.takeInfo(info)) {
+            aiStats = info.stats;
+            dirty = true;
+        }
+    }
+    
+    void cancelAIMove() {
+        ai.cancel();
+        isAIThinking = false;
+        isAIPondering = false;
+    }
+    
+    static void setQuad(sf::Vertex* quad, float x, float y, float size, sf::Color color) {
+        quad[0] = sf::Vertex(sf::Vector2f(x, y), color);
+        quad[1] = sf::Vertex(sf::Vector2f(x + size, y), color);
+        quad[2] = sf::Vertex(sf::Vector2f(x + size, y + size), color);
+        quad[3] = sf::Vertex(sf::Vector2f(x, y + size), color);
+    }
+    
+    // The squares never change, so they are built once.
+    void buildBoard() {
         for (int row = 0; row < 8; row++) {
             for (int col = 0; col < 8; col++) {
-                sf::RectangleShape square(sf::Vector2f(100, 100));
-                square.setPosition(col * 100, row * 100);
-                
-                // Alternate colors
-                if ((row + col) % 2 == 0) {
-                    square.setFillColor(lightSquare);
-                } else {
-                    square.setFillColor(darkSquare);
-                }
-                
-                window.draw(square);
-                
-                // Highlight selected square
-                if (pieceSelected && selectedSquare.row == row && selectedSquare.col == col) {
-                    sf::RectangleShape highlight(sf::Vector2f(100, 100));
-                    highlight.setPosition(col * 100, row * 100);
-                    highlight.setFillColor(selectedColor);
-                    window.draw(highlight);
-                }
-                
-                // Highlight last move
-                if (!moveHistory.empty()) {
-                    Move lastMove = moveHistory.back();
-                    if ((lastMove.from.row == row && lastMove.from.col == col) ||
-                        (lastMove.to.row == row && lastMove.to.col == col)) {
-                        sf::RectangleShape highlight(sf::Vector2f(100, 100));
-                        highlight.setPosition(col * 100, row * 100);
-                        highlight.setFillColor(lastMoveColor);
-                        window.draw(highlight);
-                    }
-                }
+                sf::Color color = ((row + col) % 2 == 0) ? lightSquare : darkSquare;
+                setQuad(&boardVertices[squareOf(row, col) * 4], col * SQUARE_SIZE, row * SQUARE_SIZE, SQUARE_SIZE,
+                        color);
+            }
+        }
+    }
+    
+    void buildPieceAtlas() {
+        pieceAtlas.create(6 * SQUARE_SIZE, 2 * SQUARE_SIZE);
+        pieceAtlas.clear(sf::Color::Transparent);
+        for (int colorRow = 0; colorRow < 2; colorRow++) {
+            PieceColor color = (colorRow == 0) ? WHITE : BLACK;
+            for (int type = PAWN; type <= KING; type++) {
+                sf::Text pieceText;
+                pieceText.setFont(font);
+                pieceText.setString(getPieceSymbol(Piece(PieceType(type), color)));
+                pieceText.setCharacterSize(60);
+                pieceText.setFillColor(color == WHITE ? sf::Color::White : sf::Color::Black);
                 
-                // Draw piece
-                if (board[row][col].type != EMPTY) {
-                    sf::Text pieceText;
-                    pieceText.setFont(font);
-                    pieceText.setString(getPieceSymbol(board[row][col]));
-                    pieceText.setCharacterSize(60);
-                    pieceText.setFillColor(board[row][col].color == WHITE ? sf::Color::White : sf::Color::Black);
-                    
-                    sf::FloatRect textBounds = pieceText.getLocalBounds();
-                    pieceText.setPosition(
-                        col * 100 + (100 - textBounds.width) / 2,
-                        row * 100 + (100 - textBounds.height) / 2
-                    );
-                    
-                    window.draw(pieceText);
-                }
+                sf::FloatRect textBounds = pieceText.getLocalBounds();
+                pieceText.setPosition(
+                    (type - PAWN) * SQUARE_SIZE + (SQUARE_SIZE - textBounds.width) / 2,
+                    colorRow * SQUARE_SIZE + (SQUARE_SIZE - textBounds.height) / 2
+                );
+                pieceAtlas.draw(pieceText);
             }
         }
+        pieceAtlas.display();
+    }
+    
+    Button makeButton(int x, int y, int width, int height, const std::string& text) {
+        Button button;
+        button.shape.setSize(sf::Vector2f(width, height));
+        button.shape.setPosition(x, y);
+        button.shape.setOutlineThickness(2);
+        button.shape.setOutlineColor(sf::Color::Black);
+        
+        button.label.setFont(font);
+        button.label.setString(text);
+        button.label.setCharacterSize(16);
+        button.label.setFillColor(sf::Color::White);
+        
+        sf::FloatRect textBounds = button.label.getLocalBounds();
+        button.label.setPosition(
+            x + (width - textBounds.width) / 2,
+            y + (height - textBounds.height) / 2
+        );
+        return button;
+    }
+    
+    void makeLabel(sf::Text& text, unsigned size, int x, int y) {
+        text.setFont(font);
+        text.setCharacterSize(size);
+        text.setFillColor(sf::Color::Black);
+        text.setPosition(x, y);
+    }
+    
+    void buildUI() {
+        makeLabel(statusText, 24, 820, 10);
+        makeLabel(difficultyTitle, 18, 820, 300);
+        difficultyTitle.setString("AI Difficulty:");
+        makeLabel(historyTitle, 20, 820, 400);
+        historyTitle.setString("Move History:");
+        for (int i = 0; i < HISTORY_LINES; i++) {
+            makeLabel(historyLines[i], 14, 820, 430 + i * 20);
+        }
+        makeLabel(statsTitle, 20, 820, 640);
+        statsTitle.setString("AI Search:");
+        for (int i = 0; i < STATS_LINES; i++) {
+            makeLabel(statsLines[i], 14, 820, 670 + i * 20);
+        }
         
-        // Draw UI
-        drawUI();
+        newGameButton = makeButton(820, 50, 100, 40, "New Game");
+        newGameButton.shape.setFillColor(sf::Color::Blue);
+        undoButton = makeButton(820, 100, 100, 40, "Undo Move");
+        undoButton.shape.setFillColor(sf::Color::Gray);
+        localButton = makeButton(820, 200, 160, 40, "Local Multiplayer");
+        aiButton = makeButton(820, 250, 100, 40, "VS AI");
+        easyButton = makeButton(820, 320, 50, 40, "Easy");
+        mediumButton = makeButton(880, 320, 50, 40, "Med");
+        hardButton = makeButton(940, 320, 50, 40, "Hard");
+    }
+    
+    // Brings the cached geometry and text up to date with the game.
+    void refresh() {
+        highlightVertices.clear();
+        if (pieceSelected) {
+            appendHighlight(squareOf(selectedSquare.row, selectedSquare.col), selectedColor);
+        }
+        if (!board.getMoveHistory().empty()) {
+            Move lastMove = board.getMoveHistory().back().move;
+            appendHighlight(lastMove.from(), lastMoveColor);
+            appendHighlight(lastMove.to(), lastMoveColor);
+        }
         
-        window.display();
+        pieceVertices.clear();
+        for (int square = 0; square < 64; square++) {
+            const Piece& piece = board.pieceAt(square);
+            if (piece.type == EMPTY) continue;
+            
+            float x = (square % 8) * SQUARE_SIZE;
+            float y = (square / 8) * SQUARE_SIZE;
+            float u = (piece.type - PAWN) * SQUARE_SIZE;
+            float v = (piece.color == WHITE ? 0 : 1) * SQUARE_SIZE;
+            pieceVertices.append(sf::Vertex(sf::Vector2f(x, y), sf::Vector2f(u, v)));
+            pieceVertices.append(sf::Vertex(sf::Vector2f(x + SQUARE_SIZE, y), sf::Vector2f(u + SQUARE_SIZE, v)));
+            pieceVertices.append(sf::Vertex(sf::Vector2f(x + SQUARE_SIZE, y + SQUARE_SIZE),
+                                            sf::Vector2f(u + SQUARE_SIZE, v + SQUARE_SIZE)));
+            pieceVertices.append(sf::Vertex(sf::Vector2f(x, y + SQUARE_SIZE), sf::Vector2f(u, v + SQUARE_SIZE)));
+        }
+        
+        refreshUI();
+        dirty = false;
     }
     
-    void drawUI() {
+    void appendHighlight(int square, sf::Color color) {
+        size_t first = highlightVertices.getVertexCount();
+        highlightVertices.resize(first + 4);
+        setQuad(&highlightVertices[first], (square % 8) * SQUARE_SIZE, (square / 8) * SQUARE_SIZE, SQUARE_SIZE,
+                color);
+    }
+    
+    void refreshUI() {
         // Game status
-        sf::Text statusText;
-        statusText.setFont(font);
         std::string status = isAIThinking ? "AI is thinking..." : 
-                           (currentPlayer == WHITE ? "White to move" : "Black to move");
+                           (board.getCurrentPlayer() == WHITE ? "White to move" : "Black to move");
         if (gameMode == VS_AI) {
-            status += (currentPlayer == WHITE) ? " (You)" : " (AI)";
+            status += (board.getCurrentPlayer() == WHITE) ? " (You)" : " (AI)";
+        }
+        if (!isAIThinking && getAllValidMoves(board).empty()) {
+            status = isInCheck(board) ? "Checkmate" : "Stalemate";
         }
         statusText.setString(status);
-        statusText.setCharacterSize(24);
-        statusText.setFillColor(sf::Color::Black);
-        statusText.setPosition(820, 10);
-        window.draw(statusText);
-        
-        // Buttons
-        drawButton(820, 50, 100, 40, "New Game", sf::Color::Blue);
-        drawButton(820, 100, 100, 40, "Undo Move", sf::Color::Gray);
         
         // Game mode buttons
-        sf::Color localColor = (gameMode == LOCAL_MULTIPLAYER) ? sf::Color::Green : sf::Color::Gray;
-        sf::Color aiColor = (gameMode == VS_AI) ? sf::Color::Green : sf::Color::Gray;
-        
-        drawButton(820, 200, 160, 40, "Local Multiplayer", localColor);
-        drawButton(820, 250, 100, 40, "VS AI", aiColor);
-        
-        // AI difficulty buttons (only show when in AI mode)
-        if (gameMode == VS_AI) {
-            sf::Text diffText;
-            diffText.setFont(font);
-            diffText.setString("AI Difficulty:");
-            diffText.setCharacterSize(18);
-            diffText.setFillColor(sf::Color::Black);
-            diffText.setPosition(820, 300);
-            window.draw(diffText);
-            
-            sf::Color easyColor = (aiDifficulty == 1) ? sf::Color::Green : sf::Color::Gray;
-            sf::Color mediumColor = (aiDifficulty == 2) ? sf::Color::Green : sf::Color::Gray;
-            sf::Color hardColor = (aiDifficulty == 3) ? sf::Color::Green : sf::Color::Gray;
-            
-            drawButton(820, 320, 50, 40, "Easy", easyColor);
-            drawButton(880, 320, 50, 40, "Med", mediumColor);
-            drawButton(940, 320, 50, 40, "Hard", hardColor);
-        }
+        localButton.shape.setFillColor((gameMode == LOCAL_MULTIPLAYER) ? sf::Color::Green : sf::Color::Gray);
+        aiButton.shape.setFillColor((gameMode == VS_AI) ? sf::Color::Green : sf::Color::Gray);
+        easyButton.shape.setFillColor((aiDifficulty == 1) ? sf::Color::Green : sf::Color::Gray);
+        mediumButton.shape.setFillColor((aiDifficulty == 2) ? sf::Color::Green : sf::Color::Gray);
+        hardButton.shape.setFillColor((aiDifficulty == 3) ? sf::Color::Green : sf::Color::Gray);
         
         // Move history
-        sf::Text historyTitle;
-        historyTitle.setFont(font);
-        historyTitle.setString("Move History:");
-        historyTitle.setCharacterSize(20);
-        historyTitle.setFillColor(sf::Color::Black);
-        historyTitle.setPosition(820, 400);
-        window.draw(historyTitle);
-        
-        int yPos = 430;
-        int displayMoves = std::min(10, (int)moveHistory.size());
-        for (int i = moveHistory.size() - displayMoves; i < moveHistory.size(); i++) {
-            Move move = moveHistory[i];
-            sf::Text moveText;
-            moveText.setFont(font);
-            
+        const std::vector<MoveRecord>& moveHistory = board.getMoveHistory();
+        historyLineCount = std::min(HISTORY_LINES, (int)moveHistory.size());
+        int first = (int)moveHistory.size() - historyLineCount;
+        for (int line = 0; line < historyLineCount; line++) {
+            int i = first + line;
+            const MoveRecord& move = moveHistory[i];
             std::string moveStr = std::to_string(i + 1) + ". " + 
                                  getPieceSymbol(move.piece) + 
-                                 char('a' + move.from.col) + std::to_string(8 - move.from.row) + 
-                                 "-" + char('a' + move.to.col) + std::to_string(8 - move.to.row);
+                                 char('a' + move.move.from() % 8) + std::to_string(8 - move.move.from() / 8) + 
+                                 "-" + char('a' + move.move.to() % 8) + std::to_string(8 - move.move.to() / 8);
             
             if (move.captured.type != EMPTY) {
                 moveStr += " x" + getPieceSymbol(move.captured);
             }
-            
-            moveText.setString(moveStr);
-            moveText.setCharacterSize(14);
-            moveText.setFillColor(sf::Color::Black);
-            moveText.setPosition(820, yPos);
-            window.draw(moveText);
-            
-            yPos += 20;
+            historyLines[line].setString(moveStr);
         }
+        
+        refreshStats();
     }
     
-    void drawButton(int x, int y, int width, int height, const std::string& text, sf::Color color) {
-        sf::RectangleShape button(sf::Vector2f(width, height));
-        button.setPosition(x, y);
-        button.setFillColor(color);
-        button.setOutlineThickness(2);
-        button.setOutlineColor(sf::Color::Black);
-        window.draw(button);
+    void refreshStats() {
+        std::string lines[STATS_LINES];
+        char text[64];
+        const SearchStats& stats = aiStats;
+        if (stats.depthCount > 0) {
+            const DepthStats& last = stats.depths[stats.depthCount - 1];
+            std::snprintf(text, sizeof(text), "Depth %d  score %+.2f", last.depth, last.score / 100.0);
+            lines[0] = text;
+        }
+        std::snprintf(text, sizeof(text), "Nodes %llu  (%llu kN/s)", (unsigned long long)stats.nodes,
+                      (unsigned long long)(stats.nodesPerSecond() / 1000));
+        lines[1] = text;
+#ifdef CHESS_SEARCH_STATS
+        std::snprintf(text, sizeof(text), "Quiescence %.0f%% of nodes",
+                      stats.nodes > 0 ? 100.0 * stats.quiescenceNodes / stats.nodes : 0.0);
+        lines[2] = text;
+        std::snprintf(text, sizeof(text), "Hash hits %.0f%%", 100.0 * stats.ttHitRate());
+        lines[3] = text;
+        std::snprintf(text, sizeof(text), "Cutoffs %llu  (%.0f%% first move)", (unsigned long long)stats.betaCutoffs,
+                      100.0 * stats.firstMoveCutoffRate());
+        lines[4] = text;
+#else
+        lines[2] = "Counters compiled out";
+#endif
+        for (int i = 0; i < STATS_LINES; i++) {
+            statsLines[i].setString(lines[i]);
+        }
+    }
+    
+    void draw() {
+        window.clear(sf::Color::White);
         
-        sf::Text buttonText;
-        buttonText.setFont(font);
-        buttonText.setString(text);
-        buttonText.setCharacterSize(16);
-        buttonText.setFillColor(sf::Color::White);
+        window.draw(boardVertices);
+        window.draw(highlightVertices);
+        window.draw(pieceVertices, sf::RenderStates(&pieceAtlas.getTexture()));
         
-        sf::FloatRect textBounds = buttonText.getLocalBounds();
-        buttonText.setPosition(
-            x + (width - textBounds.width) / 2,
-            y + (height - textBounds.height) / 2
-        );
+        drawUI();
         
-        window.draw(buttonText);
+        window.display();
     }
     
+    void drawUI() {
+        window.draw(statusText);
+        
+        drawButton(newGameButton);
+        drawButton(undoButton);
+        drawButton(localButton);
+        drawButton(aiButton);
+        
+        // AI difficulty buttons (only show when in AI mode)
+        if (gameMode == VS_AI) {
+            window.draw(difficultyTitle);
+            drawButton(easyButton);
+            drawButton(mediumButton);
+            drawButton(hardButton);
+        }
+        
+        window.draw(historyTitle);
+        for (int i = 0; i < historyLineCount; i++) {
+            window.draw(historyLines[i]);
+        }
+        
+        if (gameMode == VS_AI) {
+            window.draw(statsTitle);
+            for (int i = 0; i < STATS_LINES; i++) {
+                window.draw(statsLines[i]);
+            }
+        }
+    }
+    
+    void drawButton(const Button& button) {
+        window.draw(button.shape);
+        window.draw(button.label);
+    }
+    
+    void handleEvent(const sf::Event& event) {
+        if (event.type == sf::Event::Closed) {
+            cancelAIMove();
+            archiveGame(UNFINISHED);
+            window.close();
+        }
+        
+        if (event.type == sf::Event::MouseButtonPressed) {
+            if (event.mouseButton.button == sf::Mouse::Left) {
+                handleClick(event.mouseButton.x, event.mouseButton.y);
+            }
+        }
+        
+        // Pointer movement changes nothing on screen; anything else may
+        // (a click, or the window being resized or uncovered).
+        if (event.type != sf::Event::MouseMoved) dirty = true;
+    }
+    
+    // Only draws when something changed. While idle the loop sleeps inside
+    // waitEvent; while the AI thinks it polls for the move every
+    // AI_POLL_MS instead of spinning.
     void run() {
         while (window.isOpen()) {
-            sf::Event event;
-            while (window.pollEvent(event)) {
-                if (event.type == sf::Event::Closed) {
-                    window.close();
-                }
-                
-                if (event.type == sf::Event::MouseButtonPressed) {
-                    if (event.mouseButton.button == sf::Mouse::Left) {
-                        handleClick(event.mouseButton.x, event.mouseButton.y);
-                    }
-                }
-            }
-            
             // Make AI move if it's AI's turn
-            if (gameMode == VS_AI && currentPlayer == BLACK && !isAIThinking) {
+            pollAIProgress();
+            finishAIMove();
+            if (gameMode == VS_AI && board.getCurrentPlayer() == BLACK && !isAIThinking) {
                 makeAIMove();
             }
             
-            draw();
+            if (dirty) {
+                archiveIfOver();
+                refresh();
+                draw();
+            }
+            
+            sf::Event event;
+            if (isAIThinking) {
+                while (window.pollEvent(event)) {
+                    handleEvent(event);
+                }
+                if (!dirty) sf::sleep(sf::milliseconds(AI_POLL_MS));
+            } else if (window.waitEvent(event)) {
+                handleEvent(event);
+                while (window.pollEvent(event)) {
+                    handleEvent(event);
+                }
+            }
         }
     }
 };
@@ -0,0 +1,348 @@
+// Batch analysis of FEN or EPD positions, one per line, spread over a pool
+// of worker threads that each have their own search and hash table.
+//
+//   analyze [options] FILE      ('-' reads standard input)
+//     --threads N         worker threads (default: hardware threads)
+//     --depth N           search depth per position (default 8)
+//     --movetime MS       time per position instead of a fixed depth
+//     --nodes N           node budget per position
+//     --hash MB           hash per worker (default 16)
+//     --output FILE       results go here instead of standard output
+//
+// The file is streamed: at most a small window of positions per worker is
+// held in memory at once, however long the input is. Results are written in
+// input order as tab-separated columns:
+//
+//   line  id  move  san  score  depth  nodes  result
+//
+// The score is from the side to move's point of view, in centipawns or as
+// "mate N". EPD "bm" and "am" operations (best and avoid moves, in SAN) mark
+// each position solved or failed, and the totals are printed to standard
+// error at the end. Lines that are empty or start with '#' are skipped.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/board.h"
+#include "engine/movegen.h"
+#include "engine/notation.h"
+#include "engine/search.h"
+
+namespace {
+
+// Positions that may be read ahead of the oldest unfinished one, per worker.
+const int WINDOW_PER_THREAD = 4;
+
+struct Config {
+    int threads = 0;
+    int hashMegabytes = 16;
+    SearchLimits limits;
+    std::string inputFile, outputFile;
+};
+
+struct Job {
+    uint64_t index;
+    int lineNumber;
+    std::string line;
+};
+
+// The EPD operations analyze cares about.
+struct Epd {
+    std::string id;
+    std::vector<std::string> bestMoves;
+    std::vector<std::string> avoidMoves;
+};
+
+enum Verdict {
+    UNSCORED,  // no bm or am operation
+    SOLVED,
+    FAILED,
+    INVALID    // the position could not be read
+};
+
+struct Result {
+    bool ready = false;
+    std::string text;
+    Verdict verdict = UNSCORED;
+};
+
+// Splits "bm Nf3 e4; id \"WAC.001\";" into operations. Operands are
+// whitespace-separated; quoted operands may contain spaces.
+Epd parseOperations(const std::string& operations) {
+    Epd epd;
+    std::stringstream in(operations);
+    std::string operation;
+    while (std::getline(in, operation, ';')) {
+        std::istringstream words(operation);
+        std::string opcode;
+        if (!(words >> opcode)) continue;
+
+        std::vector<std::string> operands;
+        std::string operand;
+        while (words >> operand) {
+            if (operand[0] == '"') {
+                std::string rest;
+                std::getline(words, rest, '"');
+                operand = operand.substr(1);
+                if (!operand.empty() && operand.back() == '"') operand.pop_back();
+                else operand += rest;
+            }
+            operands.push_back(operand);
+        }
+        if (opcode == "id" && !operands.empty()) epd.id = operands[0];
+        else if (opcode == "bm") epd.bestMoves = operands;
+        else if (opcode == "am") epd.avoidMoves = operands;
+    }
+    return epd;
+}
+
+// The first four fields are the position; in EPD the rest are operations,
+// in FEN they are the two move counters.
+std::string operationsOf(const std::string& line) {
+    size_t position = 0;
+    for (int field = 0; field < 4; field++) {
+        position = line.find_first_not_of(" \t", position);
+        if (position == std::string::npos) return "";
+        position = line.find_first_of(" \t", position);
+        if (position == std::string::npos) return "";
+    }
+    return line.substr(position);
+}
+
+std::string formatScore(int score) {
+    if (isMateScore(score)) return "mate " + std::to_string(mateInMoves(score));
+    return std::to_string(score);
+}
+
+bool listed(const Board& board, const std::vector<std::string>& moves, Move move) {
+    for (const std::string& text : moves) {
+        if (parseMove(board, text) == move) return true;
+    }
+    return false;
+}
+
+Result analyzePosition(Search& search, const SearchLimits& limits, const Job& job) {
+    Result result;
+    Board board;
+    if (!board.loadFEN(job.line)) {
+        result.verdict = INVALID;
+        result.text = std::to_string(job.lineNumber) + "\t-\t-\t-\t-\t-\t-\tinvalid";
+        return result;
+    }
+    Epd epd = parseOperations(operationsOf(job.line));
+
+    int score = 0, depth = 0;
+    search.setInfoCallback([&](const SearchInfo& info) {
+        score = info.score;
+        depth = info.depth;
+    });
+    search.setPosition(board);
+    Move best = search.getBestMove(limits);
+    if (board.getCurrentPlayer() == BLACK) score = -score;
+
+    std::string verdictText = "-";
+    if (!epd.bestMoves.empty() || !epd.avoidMoves.empty()) {
+        bool solved = !best.isNull();
+        if (!epd.bestMoves.empty()) solved = solved && listed(board, epd.bestMoves, best);
+        if (!epd.avoidMoves.empty()) solved = solved && !listed(board, epd.avoidMoves, best);
+        result.verdict = solved ? SOLVED : FAILED;
+        verdictText = solved ? "solved" : "failed";
+    }
+
+    result.text = std::to_string(job.lineNumber) + "\t" + (epd.id.empty() ? "-" : epd.id) + "\t" +
+                  moveToString(best) + "\t" + (best.isNull() ? "-" : moveToSan(board, best)) + "\t" +
+                  formatScore(score) + "\t" + std::to_string(depth) + "\t" + std::to_string(search.getNodes()) +
+                  "\t" + verdictText;
+    return result;
+}
+
+// Jobs flow from the reading thread to the workers through `pending`;
+// results come back into a ring of `window` slots indexed by input order,
+// and whichever worker completes the oldest slot writes out every finished
+// result from there on. The reader never gets more than `window` positions
+// ahead of the writer, which is what bounds memory.
+class Pipeline {
+public:
+    Pipeline(const Config& config, std::FILE* output)
+        : config(config), output(output), window(config.threads * WINDOW_PER_THREAD), slots(window),
+          nextIndex(0), nextToWrite(0), inputDone(false) {}
+
+    void run(std::istream& in) {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < config.threads; i++) {
+            workers.emplace_back([this]() { work(); });
+        }
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            roomForMore.wait(lock, [this]() { return nextIndex - nextToWrite < window; });
+            pending.push_back(Job{nextIndex++, lineNumber, line});
+            jobReady.notify_one();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inputDone = true;
+        }
+        jobReady.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    uint64_t positions = 0;
+    uint64_t scored = 0;
+    uint64_t solved = 0;
+    uint64_t invalid = 0;
+
+private:
+    void work() {
+        Search search(config.hashMegabytes);
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this]() { return !pending.empty() || inputDone; });
+                if (pending.empty()) return;
+                job = std::move(pending.front());
+                pending.pop_front();
+            }
+
+            Result result = analyzePosition(search, config.limits, job);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[job.index % window] = std::move(result);
+            slots[job.index % window].ready = true;
+            flushFinished();
+        }
+    }
+
+    // Called with the mutex held.
+    void flushFinished() {
+        bool advanced = false;
+        while (slots[nextToWrite % window].ready) {
+            Result& result = slots[nextToWrite % window];
+            std::fprintf(output, "%s\n", result.text.c_str());
+            positions++;
+            if (result.verdict == INVALID) invalid++;
+            if (result.verdict == SOLVED || result.verdict == FAILED) scored++;
+            if (result.verdict == SOLVED) solved++;
+            result = Result();
+            nextToWrite++;
+            advanced = true;
+        }
+        if (advanced) roomForMore.notify_one();
+    }
+
+    const Config& config;
+    std::FILE* output;
+    const uint64_t window;
+    std::vector<Result> slots;
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable roomForMore;
+    std::deque<Job> pending;
+    uint64_t nextIndex;
+    uint64_t nextToWrite;
+    bool inputDone;
+};
+
+bool parseArguments(int argc, char** argv, Config& config) {
+    config.limits.depth = 8;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue) {
+            config.threads = std::atoi(argv[++i]);
+        } else if (arg == "--depth" && hasValue) {
+            config.limits.depth = std::atoi(argv[++i]);
+        } else if (arg == "--movetime" && hasValue) {
+            config.limits.timeMs = std::atoi(argv[++i]);
+            config.limits.depth = 0;
+        } else if (arg == "--nodes" && hasValue) {
+            config.limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+            config.limits.depth = 0;
+        } else if (arg == "--hash" && hasValue) {
+            config.hashMegabytes = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--output" && hasValue) {
+            config.outputFile = argv[++i];
+        } else if (config.inputFile.empty() && (arg == "-" || arg[0] != '-')) {
+            config.inputFile = arg;
+        } else {
+            return false;
+        }
+    }
+    if (config.inputFile.empty()) return false;
+    if (config.threads <= 0) {
+        config.threads = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parseArguments(argc, argv, config)) {
+        std::fprintf(stderr, "usage: analyze [--threads N] [--depth N | --movetime MS | --nodes N] [--hash MB]\n"
+                             "               [--output FILE] FILE\n");
+        return 1;
+    }
+
+    std::ifstream file;
+    if (config.inputFile != "-") {
+        file.open(config.inputFile);
+        if (!file) {
+            std::fprintf(stderr, "analyze: cannot open %s\n", config.inputFile.c_str());
+            return 1;
+        }
+    }
+    std::istream& in = (config.inputFile == "-") ? std::cin : file;
+
+    std::FILE* output = stdout;
+    if (!config.outputFile.empty()) {
+        output = std::fopen(config.outputFile.c_str(), "w");
+        if (!output) {
+            std::fprintf(stderr, "analyze: cannot write %s\n", config.outputFile.c_str());
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::fprintf(output, "line\tid\tmove\tsan\tscore\tdepth\tnodes\tresult\n");
+    Pipeline pipeline(config, output);
+    pipeline.run(in);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (output != stdout) std::fclose(output);
+
+    std::fprintf(stderr, "%llu positions in %.1f s (%.1f/s) on %d threads\n",
+                 (unsigned long long)pipeline.positions, seconds,
+                 seconds > 0 ? pipeline.positions / seconds : 0.0, config.threads);
+    if (pipeline.invalid > 0) {
+        std::fprintf(stderr, "%llu lines could not be read as positions\n", (unsigned long long)pipeline.invalid);
+    }
+    if (pipeline.scored > 0) {
+        std::fprintf(stderr, "solved %llu of %llu (%.1f%%)\n", (unsigned long long)pipeline.solved,
+                     (unsigned long long)pipeline.scored, 100.0 * pipeline.solved / pipeline.scored);
+    }
+    return 0;
+}
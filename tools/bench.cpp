@@ -0,0 +1,262 @@
+// Fixed-depth search benchmark. Each position is searched several times and
+// the median wall time is reported, so runs on the same machine are
+// comparable; with one thread, node counts are deterministic.
+//
+// The transposition table is cleared before every run. Heap allocations
+// made inside getBestMove are counted too; with one thread there should be
+// none.
+//
+//   bench [depth] [repeats] [hash MB] [threads]
+//   bench smp [depth] [repeats]    time-to-depth speedup for 1-16 threads
+//
+// Depth counts the root move. Any of --no-aspiration, --no-null, --no-lmr
+// and --no-futility switches that search feature off, to measure it.
+// --nnue FILE runs the positions a second time evaluating with that
+// network, so both evaluations are timed on the same searches.
+// --bitbases FILE also times probes of those tables on random positions
+// from several endings.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "engine/bitbase.h"
+#include "engine/board.h"
+#include "engine/movegen.h"
+#include "engine/nnue.h"
+#include "engine/search.h"
+
+// Every operator new in the process goes through here.
+static std::atomic<uint64_t> allocationCount(0);
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+struct BenchPosition {
+    const char* name;
+    const char* fen;
+};
+
+static const BenchPosition benchPositions[] = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+    {"italian", "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R w KQkq - 4 5"},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P3/2NP1N2/PPP2PPP/R4RK1 w - - 0 10"},
+    {"black", "r1bq1rk1/pp2bppp/2n1pn2/2pp4/3P4/2PBPN2/PP1N1PPP/R1BQ1RK1 b - - 0 8"},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+};
+
+struct BenchTotals {
+    uint64_t nodes;
+    double seconds;
+    uint64_t allocations;
+};
+
+static bool runBench(int depth, int repeats, int hashMegabytes, int threads, const SearchOptions& options,
+                     std::shared_ptr<const nnue::Network> network, bool verbose, BenchTotals& totals) {
+    totals = BenchTotals{0, 0, 0};
+    Search search(hashMegabytes);
+    search.setThreads(threads);
+    search.setOptions(options);
+    search.setNetwork(std::move(network));
+
+    for (const BenchPosition& position : benchPositions) {
+        Board board;
+        if (!board.loadFEN(position.fen)) {
+            std::fprintf(stderr, "bench: invalid FEN for %s\n", position.name);
+            return false;
+        }
+
+        std::vector<double> times;
+        times.reserve(repeats);
+        Move best;
+        uint64_t allocations = 0;
+        for (int i = 0; i < repeats; i++) {
+            search.setPosition(board);
+            search.clearHash();
+            uint64_t allocationsBefore = allocationCount.load();
+            auto start = std::chrono::steady_clock::now();
+            best = search.getBestMove(SearchLimits::fixedDepth(depth));
+            times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            allocations = allocationCount.load() - allocationsBefore;
+        }
+        std::sort(times.begin(), times.end());
+        double seconds = times[times.size() / 2];
+        uint64_t nodes = search.getNodes();
+
+        if (verbose) {
+            std::printf("%-11s depth %d  nodes %10llu  time %8.3f s  nps %10.0f  allocs %4llu  best %s\n",
+                        position.name, depth, (unsigned long long)nodes, seconds,
+                        seconds > 0 ? nodes / seconds : 0.0, (unsigned long long)allocations,
+                        moveToString(best).c_str());
+        }
+        totals.nodes += nodes;
+        totals.seconds += seconds;
+        totals.allocations += allocations;
+    }
+    return true;
+}
+
+// Lazy SMP gains come from reaching the same depth sooner, so the speedup is
+// the single-thread time divided by the N-thread time at a fixed depth.
+static int runSmpCurve(int depth, int repeats, const SearchOptions& options) {
+    const int threadCounts[] = {1, 2, 4, 8, 16};
+    double baseline = 0;
+
+    std::printf("threads  time (s)   speedup  nodes       nps\n");
+    for (int threads : threadCounts) {
+        BenchTotals totals;
+        if (!runBench(depth, repeats, 64, threads, options, nullptr, false, totals)) return 1;
+        if (threads == 1) baseline = totals.seconds;
+        std::printf("%7d  %8.3f  %8.2f  %10llu  %10.0f\n", threads, totals.seconds,
+                    totals.seconds > 0 ? baseline / totals.seconds : 0.0, (unsigned long long)totals.nodes,
+                    totals.seconds > 0 ? totals.nodes / totals.seconds : 0.0);
+    }
+    return 0;
+}
+
+// Pieces placed at random on distinct squares, pawns off the back ranks,
+// as FEN for boards the probe reads the way the search hands them over.
+static std::string randomEndingFen(const char* pieces, std::mt19937_64& random) {
+    for (;;) {
+        char squares[64];
+        std::fill(squares, squares + 64, '\0');
+        bool placed = true;
+        for (const char* piece = pieces; *piece && placed; piece++) {
+            int square = int(random() % 64);
+            bool pawn = (*piece == 'P' || *piece == 'p');
+            placed = !squares[square] && !(pawn && (square < 8 || square >= 56));
+            squares[square] = *piece;
+        }
+        if (!placed) continue;
+
+        std::string fen;
+        for (int row = 0; row < 8; row++) {
+            int empty = 0;
+            for (int col = 0; col < 8; col++) {
+                char piece = squares[row * 8 + col];
+                if (!piece) {
+                    empty++;
+                    continue;
+                }
+                if (empty) fen += char('0' + empty);
+                empty = 0;
+                fen += piece;
+            }
+            if (empty) fen += char('0' + empty);
+            if (row < 7) fen += '/';
+        }
+        return fen + ((random() & 1) ? " w - - 0 1" : " b - - 0 1");
+    }
+}
+
+static int runBitbaseProbes(const char* path) {
+    bitbase::Bitbases bitbases;
+    if (!bitbases.open(path)) {
+        std::fprintf(stderr, "bench: cannot open bitbases %s\n", path);
+        return 1;
+    }
+    const char* endings[] = {"KQk", "KRk", "KPk", "KQkr", "KRkb", "KBNk", "KRPk", "KPkp", "kqKR", "kpKN"};
+    const int positionsPerEnding = 10000;
+    const int rounds = 20;
+
+    std::mt19937_64 random(1);
+    std::vector<Board> boards;
+    for (const char* ending : endings) {
+        for (int i = 0; i < positionsPerEnding; i++) {
+            boards.emplace_back();
+            boards.back().loadFEN(randomEndingFen(ending, random));
+        }
+    }
+    std::shuffle(boards.begin(), boards.end(), random);
+
+    uint64_t probes = 0, hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const Board& board : boards) {
+            bitbase::Result result;
+            hits += bitbases.probe(board, result);
+            probes++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("\nbitbases (%zu tables)\n", bitbases.getTableCount());
+    std::printf("probes %llu  found %llu  time %8.3f s  %.1f ns/probe\n", (unsigned long long)probes,
+                (unsigned long long)hits, seconds, probes > 0 ? seconds * 1e9 / probes : 0.0);
+    return 0;
+}
+
+static void printTotals(const char* label, const BenchTotals& totals) {
+    std::printf("%-11s nodes %10llu  time %8.3f s  nps %10.0f  allocs %4llu\n", label,
+                (unsigned long long)totals.nodes, totals.seconds,
+                totals.seconds > 0 ? totals.nodes / totals.seconds : 0.0, (unsigned long long)totals.allocations);
+}
+
+int main(int argc, char** argv) {
+    // Feature switches can go anywhere; what is left is positional.
+    SearchOptions options;
+    const char* networkFile = nullptr;
+    const char* bitbaseFile = nullptr;
+    std::vector<char*> args;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--nnue") == 0 && i + 1 < argc) networkFile = argv[++i];
+        else if (std::strcmp(argv[i], "--bitbases") == 0 && i + 1 < argc) bitbaseFile = argv[++i];
+        else if (std::strcmp(argv[i], "--no-aspiration") == 0) options.aspirationWindows = false;
+        else if (std::strcmp(argv[i], "--no-null") == 0) options.nullMove = false;
+        else if (std::strcmp(argv[i], "--no-lmr") == 0) options.lateMoveReductions = false;
+        else if (std::strcmp(argv[i], "--no-futility") == 0) options.futilityPruning = false;
+        else args.push_back(argv[i]);
+    }
+    int count = int(args.size());
+
+    if (count > 0 && std::strcmp(args[0], "smp") == 0) {
+        int depth = (count > 1) ? std::atoi(args[1]) : 6;
+        int repeats = (count > 2) ? std::max(1, std::atoi(args[2])) : 3;
+        return runSmpCurve(depth, repeats, options);
+    }
+
+    int depth = (count > 0) ? std::atoi(args[0]) : 8;
+    int repeats = (count > 1) ? std::max(1, std::atoi(args[1])) : 3;
+    int hashMegabytes = (count > 2) ? std::max(1, std::atoi(args[2])) : 16;
+    int threads = (count > 3) ? std::max(1, std::atoi(args[3])) : 1;
+
+    std::shared_ptr<nnue::Network> network;
+    if (networkFile) {
+        network = std::make_shared<nnue::Network>();
+        if (!network->open(networkFile)) {
+            std::fprintf(stderr, "bench: cannot open network %s\n", networkFile);
+            return 1;
+        }
+    }
+
+    BenchTotals totals;
+    if (!runBench(depth, repeats, hashMegabytes, threads, options, nullptr, true, totals)) return 1;
+    printTotals("total", totals);
+
+    if (network) {
+        std::printf("\nnnue (%s kernels)\n", nnue::simdName());
+        if (!runBench(depth, repeats, hashMegabytes, threads, options, network, true, totals)) return 1;
+        printTotals("nnue total", totals);
+    }
+    if (bitbaseFile) return runBitbaseProbes(bitbaseFile);
+    return 0;
+}
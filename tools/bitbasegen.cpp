@@ -0,0 +1,432 @@
+// Generates the win/draw/loss bitbases (engine/bitbase.h) for every ending
+// of three and four pieces by retrograde analysis, and writes them to one
+// file.
+//
+//   bitbasegen <out.bin> [threads]    (default: hardware threads)
+//
+// Tables are built smallest first, and pawnless before pawns, so a capture
+// or promotion always leads into a table that is already done. For each
+// table:
+//
+//   1. Every position is scored on its own: illegal, mate or stalemate,
+//      won through a capture or promotion into a finished table, or else
+//      left open with a count of its moves that stay in the table.
+//   2. From each position decided in the last round, moves are taken back
+//      to find the positions before it. One that can move into a lost
+//      position is won; one whose count of moves not yet known to lose
+//      reaches zero is lost.
+//   3. When a round decides nothing, every open position is a draw.
+//
+// Each step runs on all threads over chunks of the index range; positions
+// are claimed with atomic operations, so the threads never wait on each
+// other within a round.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/bitbase.h"
+#include "engine/bitboard.h"
+
+using bitbase::Setup;
+using bitbase::TableLayout;
+
+namespace {
+
+const uint64_t CHUNK = 1 << 14;
+
+// Positions during generation. WON and LOST are for the side to move.
+const uint8_t OPEN = 0;
+const uint8_t WON = 1;
+const uint8_t LOST = 2;
+const uint8_t DRAWN = 3;
+const uint8_t ILLEGAL = 4;
+
+const uint16_t UNDECIDED = 0xFFFF;
+
+struct FinishedTable {
+    TableLayout layout;
+    std::vector<unsigned char> bits;
+};
+
+// Finished tables by material key.
+typedef std::map<uint32_t, FinishedTable> TableSet;
+
+// Runs `work(begin, end)` over [0, size) in chunks on `threads` threads.
+template <typename Work>
+void parallelFor(int threads, uint64_t size, const Work& work) {
+    std::atomic<uint64_t> next(0);
+    auto run = [&]() {
+        for (uint64_t begin = next.fetch_add(CHUNK); begin < size; begin = next.fetch_add(CHUNK)) {
+            work(begin, std::min(size, begin + CHUNK));
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++) {
+        pool.emplace_back(run);
+    }
+    run();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
+// Squares a piece attacks; pawns only their captures.
+Bitboard attacksFrom(const Piece& piece, int square, Bitboard occupied) {
+    switch (piece.type) {
+        case PAWN: return attackTables.pawn[piece.color][square];
+        case KNIGHT: return attackTables.knight[square];
+        case BISHOP: return bishopAttacks(square, occupied);
+        case ROOK: return rookAttacks(square, occupied);
+        case QUEEN: return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+        default: return attackTables.king[square];
+    }
+}
+
+// The result of the position after a capture or promotion, for its side to
+// move.
+bitbase::Result convertedResult(const TableSet& finished, Setup& setup) {
+    if (setup.count == 2) return bitbase::DRAW;
+    auto table = finished.find(bitbase::materialKey(setup));
+    if (table == finished.end()) {
+        bitbase::flipColors(setup);
+        table = finished.find(bitbase::materialKey(setup));
+    }
+    return bitbase::resultAt(table->second.bits.data(), table->second.layout.index(setup));
+}
+
+class Generator {
+public:
+    Generator(const TableLayout& tableLayout, const TableSet& finishedTables, int threadCount)
+        : layout(tableLayout), finished(finishedTables), threads(threadCount), size(layout.getSize()),
+          states(new std::atomic<uint8_t>[size]()), counts(new std::atomic<uint8_t>[size]()),
+          rounds(new std::atomic<uint16_t>[size]()) {}
+
+    // Returns the number of rounds.
+    int run() {
+        parallelFor(threads, size, [this](uint64_t begin, uint64_t end) {
+            for (uint64_t index = begin; index < end; index++) {
+                classify(index);
+            }
+        });
+
+        int round = 0;
+        for (;; round++) {
+            std::atomic<uint64_t> decided(0);
+            parallelFor(threads, size, [this, round, &decided](uint64_t begin, uint64_t end) {
+                uint64_t count = 0;
+                for (uint64_t index = begin; index < end; index++) {
+                    uint8_t state = states[index].load(std::memory_order_relaxed);
+                    if ((state == WON || state == LOST) && rounds[index].load(std::memory_order_relaxed) == round) {
+                        count += propagate(index, state == LOST, uint16_t(round + 1));
+                    }
+                }
+                decided += count;
+            });
+            if (decided == 0) break;
+        }
+        return round + 1;
+    }
+
+    // The packed table, with illegal and open positions as draws.
+    std::vector<unsigned char> pack(uint64_t totals[5]) const {
+        std::vector<unsigned char> bits((size + 3) / 4, 0);
+        for (uint64_t index = 0; index < size; index++) {
+            uint8_t state = states[index].load(std::memory_order_relaxed);
+            totals[state]++;
+            int code = (state == WON) ? bitbase::WIN : (state == LOST) ? bitbase::LOSS : bitbase::DRAW;
+            bits[index >> 2] |= (unsigned char)(code << (2 * (index & 3)));
+        }
+        return bits;
+    }
+
+private:
+    int kingSlot(PieceColor color) const { return color == WHITE ? 0 : 1; }
+
+    // Step 1 for one index.
+    void classify(uint64_t index) {
+        int squares[bitbase::MAX_PIECES];
+        PieceColor side;
+        layout.decode(index, squares, side);
+        int count = layout.getPieceCount();
+
+        Bitboard occupied = 0;
+        for (int slot = 0; slot < count; slot++) {
+            occupied |= squareBB(squares[slot]);
+        }
+        if (popCount(occupied) != count || layout.index(squares, side) != index ||
+            isAttacked(squares, -1, squares[kingSlot(opponent(side))], side, occupied)) {
+            states[index].store(ILLEGAL, std::memory_order_relaxed);
+            return;
+        }
+
+        Bitboard own = 0;
+        for (int slot = 0; slot < count; slot++) {
+            if (layout.getPiece(slot).color == side) own |= squareBB(squares[slot]);
+        }
+        Bitboard enemy = occupied ^ own;
+
+        int stays = 0, legal = 0;
+        bool drawn = false;
+        for (int slot = 0; slot < count; slot++) {
+            const Piece& piece = layout.getPiece(slot);
+            if (piece.color != side) continue;
+            int from = squares[slot];
+
+            Bitboard targets;
+            if (piece.type == PAWN) {
+                int step = (side == WHITE) ? -8 : 8;
+                targets = attackTables.pawn[side][from] & enemy;
+                if (!(occupied & squareBB(from + step))) {
+                    targets |= squareBB(from + step);
+                    int startRow = (side == WHITE) ? 6 : 1;
+                    if (from / 8 == startRow && !(occupied & squareBB(from + 2 * step))) {
+                        targets |= squareBB(from + 2 * step);
+                    }
+                }
+            } else {
+                targets = attacksFrom(piece, from, occupied) & ~own;
+            }
+
+            while (targets) {
+                int to = popLSB(targets);
+                int captured = -1;
+                for (int other = 0; other < count; other++) {
+                    if (other != slot && squares[other] == to) captured = other;
+                }
+                squares[slot] = to;
+                int king = squares[kingSlot(side)];
+                bool isLegal = !isAttacked(squares, captured, king, opponent(side),
+                                           (occupied ^ squareBB(from)) | squareBB(to));
+                squares[slot] = from;
+                if (!isLegal) continue;
+                legal++;
+
+                bool promotion = piece.type == PAWN && (to / 8 == 0 || to / 8 == 7);
+                if (captured < 0 && !promotion) {
+                    stays++;
+                    continue;
+                }
+                for (PieceType type : {QUEEN, ROOK, BISHOP, KNIGHT}) {
+                    Setup child;
+                    child.sideToMove = opponent(side);
+                    for (int other = 0; other < count; other++) {
+                        if (other == captured) continue;
+                        child.pieces[child.count] = layout.getPiece(other);
+                        child.squares[child.count] = squares[other];
+                        if (other == slot) {
+                            child.squares[child.count] = to;
+                            if (promotion) child.pieces[child.count].type = type;
+                        }
+                        child.count++;
+                    }
+                    bitbase::Result result = convertedResult(finished, child);
+                    if (result == bitbase::LOSS) {
+                        states[index].store(WON, std::memory_order_relaxed);
+                        return;
+                    }
+                    if (result == bitbase::DRAW) drawn = true;
+                    if (!promotion) break;
+                }
+            }
+        }
+
+        if (legal == 0) {
+            bool inCheck = isAttacked(squares, -1, squares[kingSlot(side)], opponent(side), occupied);
+            states[index].store(inCheck ? LOST : DRAWN, std::memory_order_relaxed);
+        } else if (stays == 0) {
+            states[index].store(drawn ? DRAWN : LOST, std::memory_order_relaxed);
+        } else {
+            // A move that draws is never refuted, so the count cannot reach
+            // zero. The round is set apart from every real one until the
+            // position is decided, as a thread may see it decided before it
+            // sees the round it was decided in.
+            counts[index].store(uint8_t(stays + (drawn ? 1 : 0)), std::memory_order_relaxed);
+            rounds[index].store(UNDECIDED, std::memory_order_relaxed);
+        }
+    }
+
+    // Step 2 for one decided position; returns how many positions it
+    // decided.
+    int propagate(uint64_t index, bool lost, uint16_t round) {
+        int squares[bitbase::MAX_PIECES];
+        PieceColor side;
+        layout.decode(index, squares, side);
+        PieceColor mover = opponent(side);
+        int count = layout.getPieceCount();
+        Bitboard occupied = 0;
+        for (int slot = 0; slot < count; slot++) {
+            occupied |= squareBB(squares[slot]);
+        }
+
+        int decided = 0;
+        for (int slot = 0; slot < count; slot++) {
+            const Piece& piece = layout.getPiece(slot);
+            if (piece.color != mover) continue;
+            int to = squares[slot];
+
+            // Squares the piece can have come from without capturing.
+            Bitboard sources;
+            if (piece.type == PAWN) {
+                int step = (mover == WHITE) ? 8 : -8;
+                int back = to + step;
+                sources = 0;
+                if (back / 8 >= 1 && back / 8 <= 6 && !(occupied & squareBB(back))) {
+                    sources |= squareBB(back);
+                    int doubleRow = (mover == WHITE) ? 4 : 3;
+                    if (to / 8 == doubleRow && !(occupied & squareBB(back + step))) sources |= squareBB(back + step);
+                }
+            } else {
+                sources = attacksFrom(piece, to, occupied) & ~occupied;
+            }
+
+            while (sources) {
+                squares[slot] = popLSB(sources);
+                uint64_t before = layout.index(squares, mover);
+                if (states[before].load(std::memory_order_relaxed) != OPEN) continue;
+
+                uint8_t open = OPEN;
+                if (lost) {
+                    if (states[before].compare_exchange_strong(open, WON)) {
+                        rounds[before].store(round, std::memory_order_relaxed);
+                        decided++;
+                    }
+                } else if (counts[before].fetch_sub(1) == 1) {
+                    if (states[before].compare_exchange_strong(open, LOST)) {
+                        rounds[before].store(round, std::memory_order_relaxed);
+                        decided++;
+                    }
+                }
+            }
+            squares[slot] = to;
+        }
+        return decided;
+    }
+
+    // Whether `by` attacks `target`, leaving out the piece in slot `skip`.
+    bool isAttacked(const int* squares, int skip, int target, PieceColor by, Bitboard occupied) const {
+        for (int slot = 0; slot < layout.getPieceCount(); slot++) {
+            const Piece& piece = layout.getPiece(slot);
+            if (slot == skip || piece.color != by) continue;
+            if (attacksFrom(piece, squares[slot], occupied) & squareBB(target)) return true;
+        }
+        return false;
+    }
+
+    const TableLayout& layout;
+    const TableSet& finished;
+    int threads;
+    uint64_t size;
+    std::unique_ptr<std::atomic<uint8_t>[]> states;
+    std::unique_ptr<std::atomic<uint8_t>[]> counts;  // moves of an open position not yet known to lose
+    std::unique_ptr<std::atomic<uint16_t>[]> rounds;  // when a position was decided
+};
+
+// Every material of three and four pieces, in generation order.
+std::vector<std::string> tableNames() {
+    const char types[] = "QRBNP";
+    std::vector<std::string> names;
+    for (int i = 0; i < 5; i++) {
+        names.push_back(std::string("K") + types[i] + "K");
+    }
+    for (int i = 0; i < 5; i++) {
+        for (int j = i; j < 5; j++) {
+            names.push_back(std::string("K") + types[i] + types[j] + "K");
+            names.push_back(std::string("K") + types[i] + "K" + types[j]);
+        }
+    }
+    std::stable_sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) return a.size() < b.size();
+        return std::count(a.begin(), a.end(), 'P') < std::count(b.begin(), b.end(), 'P');
+    });
+    return names;
+}
+
+void writeLittleEndian(unsigned char* bytes, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+bool writeFile(const std::string& path, const std::vector<std::string>& names, const TableSet& tables) {
+    std::vector<unsigned char> header(bitbase::HEADER_SIZE + names.size() * bitbase::DIRECTORY_ENTRY_SIZE, 0);
+    std::memcpy(header.data(), bitbase::MAGIC, sizeof(bitbase::MAGIC));
+    writeLittleEndian(&header[8], names.size(), 4);
+
+    std::vector<const FinishedTable*> order;
+    uint64_t offset = (header.size() + 63) & ~uint64_t(63);
+    for (size_t i = 0; i < names.size(); i++) {
+        TableLayout layout;
+        layout.parse(names[i]);
+        const FinishedTable& table = tables.at(layout.getMaterialKey());
+        unsigned char* entry = &header[bitbase::HEADER_SIZE + i * bitbase::DIRECTORY_ENTRY_SIZE];
+        std::memcpy(entry, names[i].data(), names[i].size());
+        writeLittleEndian(entry + bitbase::NAME_SIZE, offset, 8);
+        writeLittleEndian(entry + bitbase::NAME_SIZE + 8, layout.getSize(), 8);
+        order.push_back(&table);
+        offset = (offset + table.bits.size() + 63) & ~uint64_t(63);
+    }
+
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) return false;
+    bool written = std::fwrite(header.data(), 1, header.size(), out) == header.size();
+    uint64_t position = header.size();
+    const unsigned char padding[64] = {};
+    for (const FinishedTable* table : order) {
+        size_t pad = size_t(((position + 63) & ~uint64_t(63)) - position);
+        written = written && std::fwrite(padding, 1, pad, out) == pad;
+        written = written && std::fwrite(table->bits.data(), 1, table->bits.size(), out) == table->bits.size();
+        position += pad + table->bits.size();
+    }
+    return std::fclose(out) == 0 && written;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: bitbasegen <out.bin> [threads]\n");
+        return 1;
+    }
+    int threads = (argc > 2) ? std::atoi(argv[2]) : int(std::thread::hardware_concurrency());
+    threads = std::max(1, threads);
+
+    std::vector<std::string> names = tableNames();
+    TableSet tables;
+    std::printf("%-6s %12s %7s %7s %7s %7s %9s\n", "table", "positions", "win%", "draw%", "loss%", "rounds",
+                "seconds");
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& name : names) {
+        auto tableStart = std::chrono::steady_clock::now();
+        TableLayout layout;
+        layout.parse(name);
+        Generator generator(layout, tables, threads);
+        int rounds = generator.run();
+        uint64_t totals[5] = {};
+        FinishedTable& table = tables[layout.getMaterialKey()];
+        table.layout = layout;
+        table.bits = generator.pack(totals);
+
+        double legal = double(layout.getSize() - totals[ILLEGAL]);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tableStart).count();
+        std::printf("%-6s %12.0f %7.2f %7.2f %7.2f %7d %9.2f\n", name.c_str(), legal, 100 * totals[WON] / legal,
+                    100 * (totals[DRAWN] + totals[OPEN]) / legal, 100 * totals[LOST] / legal, rounds, seconds);
+        std::fflush(stdout);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu tables in %.1f s on %d threads\n", names.size(), seconds, threads);
+
+    if (!writeFile(argv[1], names, tables)) {
+        std::fprintf(stderr, "bitbasegen: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
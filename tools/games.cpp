@@ -0,0 +1,163 @@
+// Reads the game archive (engine/archive.h) that the window and the
+// tournament tool append to.
+//
+//   games index ARCHIVE         writes the position index to ARCHIVE.idx
+//   games stats ARCHIVE         number of games, positions and results
+//   games query ARCHIVE FEN     games that reached the position, their
+//                               results and the moves played from it
+//   games export ARCHIVE        games from the start position as lines of
+//                               coordinate moves, the input of makebook
+//
+// Queries use ARCHIVE.idx when it exists and replay only the games appended
+// since it was built, so the index needs rebuilding now and then rather
+// than after every game.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "engine/archive.h"
+#include "engine/board.h"
+#include "engine/movegen.h"
+#include "engine/notation.h"
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int usage() {
+    std::fprintf(stderr, "usage: games index|stats|export ARCHIVE\n"
+                         "       games query ARCHIVE FEN\n");
+    return 1;
+}
+
+int indexArchive(const GameArchive& archive, const std::string& path) {
+    auto start = std::chrono::steady_clock::now();
+    if (!PositionIndex::build(archive, path)) {
+        std::fprintf(stderr, "games: cannot write %s\n", path.c_str());
+        return 1;
+    }
+    PositionIndex index;
+    index.open(path);
+    std::printf("%llu positions indexed in %.0f ms\n", (unsigned long long)index.getEntryCount(),
+                millisecondsSince(start));
+    return 0;
+}
+
+int printStats(const GameArchive& archive) {
+    uint64_t games = 0, positions = 0, next = 0;
+    uint64_t results[4] = {};
+    GameArchive::Game game;
+    uint64_t offset = GameArchive::FIRST_GAME;
+    while (archive.gameAt(offset, game, next)) {
+        games++;
+        positions += uint64_t(game.moveCount) + 1;
+        results[game.outcome]++;
+        offset = next;
+    }
+    std::printf("%llu games, %llu positions, %llu bytes\n", (unsigned long long)games,
+                (unsigned long long)positions, (unsigned long long)archive.getSize());
+    std::printf("white wins %llu, black wins %llu, drawn %llu, unfinished %llu\n",
+                (unsigned long long)results[WHITE_WINS], (unsigned long long)results[BLACK_WINS],
+                (unsigned long long)results[DRAWN], (unsigned long long)results[UNFINISHED]);
+    if (offset != archive.getSize()) {
+        std::fprintf(stderr, "games: damaged record at byte %llu\n", (unsigned long long)offset);
+    }
+    return 0;
+}
+
+int query(const GameArchive& archive, const PositionIndex& index, const std::string& fen) {
+    Board board;
+    if (!board.loadFEN(fen)) {
+        std::fprintf(stderr, "games: invalid FEN\n");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PositionHit> hits = findPosition(archive, index, board.getKey());
+    double lookup = millisecondsSince(start);
+
+    // Counts by GameOutcome, overall and per move played from the position.
+    uint64_t results[4] = {};
+    std::map<uint16_t, std::vector<uint64_t>> moves;
+    GameArchive::Game game;
+    uint64_t next = 0;
+    for (const PositionHit& hit : hits) {
+        results[hit.outcome]++;
+        if (!archive.gameAt(hit.gameOffset, game, next) || hit.ply >= game.moveCount) continue;
+        std::vector<uint64_t>& counts = moves[game.move(hit.ply).raw()];
+        counts.resize(4);
+        counts[hit.outcome]++;
+    }
+
+    std::printf("%zu games (+%llu =%llu -%llu, %llu unfinished) in %.3f ms\n", hits.size(),
+                (unsigned long long)results[WHITE_WINS], (unsigned long long)results[DRAWN],
+                (unsigned long long)results[BLACK_WINS], (unsigned long long)results[UNFINISHED], lookup);
+
+    std::vector<std::pair<uint64_t, uint16_t>> order;
+    for (const auto& entry : moves) {
+        uint64_t total = 0;
+        for (uint64_t count : entry.second) total += count;
+        order.push_back(std::make_pair(total, entry.first));
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (const auto& entry : order) {
+        const std::vector<uint64_t>& counts = moves[entry.second];
+        std::printf("  %-8s %8llu  +%llu =%llu -%llu\n", moveToSan(board, Move::fromRaw(entry.second)).c_str(),
+                    (unsigned long long)entry.first, (unsigned long long)counts[WHITE_WINS],
+                    (unsigned long long)counts[DRAWN], (unsigned long long)counts[BLACK_WINS]);
+    }
+    return 0;
+}
+
+int exportGames(const GameArchive& archive) {
+    uint64_t offset = GameArchive::FIRST_GAME, next = 0;
+    GameArchive::Game game;
+    while (archive.gameAt(offset, game, next)) {
+        if (!game.fen && game.moveCount > 0) {
+            std::string line;
+            for (int ply = 0; ply < game.moveCount; ply++) {
+                if (ply > 0) line += ' ';
+                line += moveToString(game.move(ply));
+            }
+            std::printf("%s\n", line.c_str());
+        }
+        offset = next;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) return usage();
+    std::string command = argv[1];
+    std::string path = argv[2];
+
+    GameArchive archive;
+    if (!archive.open(path)) {
+        std::fprintf(stderr, "games: cannot open %s\n", path.c_str());
+        return 1;
+    }
+
+    if (command == "index") return indexArchive(archive, path + ".idx");
+    if (command == "stats") return printStats(archive);
+    if (command == "export") return exportGames(archive);
+    if (command == "query" && argc >= 4) {
+        // The FEN may come as one argument or as its six fields.
+        std::string fen = argv[3];
+        for (int i = 4; i < argc; i++) {
+            fen += ' ';
+            fen += argv[i];
+        }
+        PositionIndex index;
+        index.open(path + ".idx");
+        return query(archive, index, fen);
+    }
+    return usage();
+}
@@ -0,0 +1,186 @@
+// Build step: finds magic numbers for rook and bishop attack lookup, checks
+// each against every blocker set of its square, and writes the magics and
+// the attack table as C++ source (see SliderMagic in engine/bitboard.h).
+//
+//   genmagics <output.cpp> [pext]
+//
+// With "pext" the table is laid out for PEXT indexing instead. The search
+// uses a fixed seed, so the output is the same on every build.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef uint64_t Bitboard;
+
+const int EXPECTED_TABLE_SIZE = 102400 + 5248;
+
+const int rookSteps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+const int bishopSteps[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+bool onBoard(int row, int col) {
+    return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+// Attacks by walking each ray until it leaves the board or hits a piece.
+Bitboard slowAttacks(const int steps[4][2], int square, Bitboard occupied) {
+    Bitboard attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int r = square / 8 + steps[d][0];
+        int c = square % 8 + steps[d][1];
+        while (onBoard(r, c)) {
+            attacks |= Bitboard(1) << (r * 8 + c);
+            if (occupied & (Bitboard(1) << (r * 8 + c))) break;
+            r += steps[d][0];
+            c += steps[d][1];
+        }
+    }
+    return attacks;
+}
+
+// Squares whose occupancy can change the attacks: each ray without its
+// last square, since a piece on the edge blocks nothing further.
+Bitboard relevantMask(const int steps[4][2], int square) {
+    Bitboard mask = 0;
+    for (int d = 0; d < 4; d++) {
+        int r = square / 8 + steps[d][0];
+        int c = square % 8 + steps[d][1];
+        while (onBoard(r + steps[d][0], c + steps[d][1])) {
+            mask |= Bitboard(1) << (r * 8 + c);
+            r += steps[d][0];
+            c += steps[d][1];
+        }
+    }
+    return mask;
+}
+
+Bitboard softwarePext(Bitboard value, Bitboard mask) {
+    Bitboard result = 0;
+    for (Bitboard bit = 1; mask; bit <<= 1) {
+        if (value & mask & -mask) result |= bit;
+        mask &= mask - 1;
+    }
+    return result;
+}
+
+struct Entry {
+    Bitboard mask;
+    Bitboard magic;
+    unsigned offset;
+    unsigned shift;
+};
+
+// Appends the attack sets of one square to `table` and returns its entry.
+bool buildSquare(const int steps[4][2], int square, bool pext, std::mt19937_64& random,
+                 std::vector<Bitboard>& table, Entry& entry) {
+    entry.mask = relevantMask(steps, square);
+    int bits = __builtin_popcountll(entry.mask);
+    size_t size = size_t(1) << bits;
+    entry.offset = unsigned(table.size());
+    entry.shift = unsigned(64 - bits);
+    entry.magic = 0;
+
+    // Every subset of the mask, by the carry-rippler trick.
+    std::vector<Bitboard> occupancies, attacks;
+    Bitboard subset = 0;
+    do {
+        occupancies.push_back(subset);
+        attacks.push_back(slowAttacks(steps, square, subset));
+        subset = (subset - entry.mask) & entry.mask;
+    } while (subset);
+
+    std::vector<Bitboard> slots(size);
+    if (pext) {
+        for (size_t i = 0; i < occupancies.size(); i++) {
+            slots[softwarePext(occupancies[i], entry.mask)] = attacks[i];
+        }
+        table.insert(table.end(), slots.begin(), slots.end());
+        return true;
+    }
+
+    // Sparse random candidates work best; a candidate is accepted once no
+    // two blocker sets with different attacks share an index. Attack sets
+    // are never empty, so zero marks an unused slot.
+    for (int attempt = 0; attempt < 100000000; attempt++) {
+        Bitboard magic = random() & random() & random();
+        if (__builtin_popcountll((entry.mask * magic) & 0xFF00000000000000ULL) < 6) continue;
+
+        std::fill(slots.begin(), slots.end(), 0);
+        bool collision = false;
+        for (size_t i = 0; i < occupancies.size() && !collision; i++) {
+            Bitboard& slot = slots[(occupancies[i] * magic) >> entry.shift];
+            if (slot == 0) slot = attacks[i];
+            else if (slot != attacks[i]) collision = true;
+        }
+        if (!collision) {
+            entry.magic = magic;
+            table.insert(table.end(), slots.begin(), slots.end());
+            return true;
+        }
+    }
+    return false;
+}
+
+void writeEntries(FILE* out, const char* name, const Entry* entries) {
+    std::fprintf(out, "const SliderMagic %s[64] = {\n", name);
+    for (int square = 0; square < 64; square++) {
+        const Entry& e = entries[square];
+        std::fprintf(out, "    {0x%016llxULL, 0x%016llxULL, %u, %u},\n", (unsigned long long)e.mask,
+                     (unsigned long long)e.magic, e.offset, e.shift);
+    }
+    std::fprintf(out, "};\n\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: genmagics <output.cpp> [pext]\n");
+        return 1;
+    }
+    bool pext = argc > 2 && std::string(argv[2]) == "pext";
+
+    std::mt19937_64 random(0x5DEECE66DULL);
+    std::vector<Bitboard> table;
+    Entry rook[64], bishop[64];
+    for (int square = 0; square < 64; square++) {
+        if (!buildSquare(rookSteps, square, pext, random, table, rook[square])) {
+            std::fprintf(stderr, "genmagics: no rook magic for square %d\n", square);
+            return 1;
+        }
+    }
+    for (int square = 0; square < 64; square++) {
+        if (!buildSquare(bishopSteps, square, pext, random, table, bishop[square])) {
+            std::fprintf(stderr, "genmagics: no bishop magic for square %d\n", square);
+            return 1;
+        }
+    }
+    if (table.size() != size_t(EXPECTED_TABLE_SIZE)) {
+        std::fprintf(stderr, "genmagics: table has %zu entries, expected %d\n", table.size(),
+                     EXPECTED_TABLE_SIZE);
+        return 1;
+    }
+
+    FILE* out = std::fopen(argv[1], "w");
+    if (!out) {
+        std::fprintf(stderr, "genmagics: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    std::fprintf(out, "// Generated by tools/genmagics.cpp (%s indexing); do not edit.\n\n",
+                 pext ? "PEXT" : "magic");
+    std::fprintf(out, "#include \"engine/bitboard.h\"\n\n");
+    writeEntries(out, "rookMagics", rook);
+    writeEntries(out, "bishopMagics", bishop);
+    std::fprintf(out, "const Bitboard sliderAttacks[SLIDER_TABLE_SIZE] = {\n");
+    for (size_t i = 0; i < table.size(); i++) {
+        std::fprintf(out, "%s0x%llxULL,%s", i % 4 == 0 ? "    " : " ", (unsigned long long)table[i],
+                     i % 4 == 3 ? "\n" : "");
+    }
+    std::fprintf(out, "\n};\n");
+    return std::fclose(out) == 0 ? 0 : 1;
+}
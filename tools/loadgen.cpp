@@ -0,0 +1,360 @@
+// Load generator for tools/server: opens connections to a server on this
+// machine, keeps many games going on each and reports how long the
+// server's engine moves take.
+//
+//   loadgen [options]
+//     --port N           the server's port (default 7474)
+//     --connections N    client connections, one thread each (default 4)
+//     --sessions N       games per connection (default 250)
+//     --requests N       engine moves to ask for in all (default 10000)
+//     --budget MS        budget sent with each `go` (default 20)
+//
+// In every game the client plays a random legal move for White, then asks
+// the server to answer for Black, and starts a new game when one ends. All
+// games of a connection run at once, so the server sees as many requests
+// in flight as there are sessions. A request answered `busy` is sent again
+// after RETRY_MS, doubling each time it is refused up to MAX_RETRY_MS; its
+// latency counts from the last send. The server's
+// counters are reset at the start, and at the end the latency percentiles
+// and requests/sec seen by the clients are printed along with the server's
+// own `stats` line.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "engine/board.h"
+#include "engine/game_server.h"
+#include "engine/movegen.h"
+#include "engine/notation.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const int RETRY_MS = 10;
+const int MAX_RETRY_MS = 1000;
+
+struct Options {
+    int port = 7474;
+    int connections = 4;
+    int sessions = 250;
+    long requests = 10000;
+    int budgetMs = 20;
+};
+
+int usage() {
+    std::fprintf(stderr, "usage: loadgen [--port N] [--connections N] [--sessions N] [--requests N] [--budget MS]\n");
+    return 1;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        long value = std::atol(argv[++i]);
+        if (value <= 0) return false;
+
+        if (arg == "--port") options.port = int(value);
+        else if (arg == "--connections") options.connections = int(value);
+        else if (arg == "--sessions") options.sessions = int(value);
+        else if (arg == "--requests") options.requests = value;
+        else if (arg == "--budget") options.budgetMs = int(value);
+        else return false;
+    }
+    return true;
+}
+
+int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    return fd;
+}
+
+// Blocking line I/O on a socket.
+class LineSocket {
+public:
+    explicit LineSocket(int socketFd) : fd(socketFd) {}
+    ~LineSocket() { close(fd); }
+
+    LineSocket(const LineSocket&) = delete;
+    LineSocket& operator=(const LineSocket&) = delete;
+
+    bool send(const std::string& line) {
+        std::string data = line + "\n";
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t count = write(fd, data.data() + sent, data.size() - sent);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            sent += size_t(count);
+        }
+        return true;
+    }
+
+    // False on timeout or a closed connection; `closed` tells them apart.
+    bool receive(std::string& line, int timeoutMs) {
+        for (;;) {
+            size_t end = input.find('\n');
+            if (end != std::string::npos) {
+                line = input.substr(0, end);
+                input.erase(0, end + 1);
+                return true;
+            }
+            pollfd entry = {fd, POLLIN, 0};
+            if (poll(&entry, 1, timeoutMs) <= 0) return false;
+            char buffer[65536];
+            ssize_t count = read(fd, buffer, sizeof(buffer));
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                closed = true;
+                return false;
+            }
+            input.append(buffer, size_t(count));
+        }
+    }
+
+    bool closed = false;
+
+private:
+    int fd;
+    std::string input;
+};
+
+// One connection's games, driven from its own thread.
+class Client {
+public:
+    Client(int socketFd, const Options& clientOptions, std::atomic<long>& requestsLeft, unsigned seed)
+        : socket(socketFd), options(clientOptions), remaining(requestsLeft), random(seed) {}
+
+    void run();
+
+    LatencyHistogram latency;
+    uint64_t completed = 0;
+    uint64_t busy = 0;
+    uint64_t errors = 0;
+
+private:
+    struct Game {
+        Board board;
+        Clock::time_point sent;
+        int retryMs = 0;  // wait before the next resend, after a `busy`
+    };
+
+    // The next step of a game: White's random move or a `go` for Black.
+    void nextTurn(uint64_t id);
+    void sendGo(uint64_t id);
+    // Plays the reply's move into the game, then the next turn or a new game.
+    void applyMove(uint64_t id, const std::string& text, const std::string& status);
+    void restart(uint64_t id);
+    void handle(const std::string& line);
+
+    LineSocket socket;
+    const Options& options;
+    std::atomic<long>& remaining;
+    std::mt19937_64 random;
+    std::unordered_map<uint64_t, Game> games;
+    std::multimap<Clock::time_point, uint64_t> retries;  // by when they are due
+    int pending = 0;  // commands sent and not yet answered
+};
+
+void Client::run() {
+    for (int i = 0; i < options.sessions; i++) {
+        socket.send("new");
+        pending++;
+    }
+    while ((pending > 0 || !retries.empty()) && !socket.closed) {
+        int timeoutMs = 1000;
+        if (!retries.empty()) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(retries.begin()->first - Clock::now());
+            timeoutMs = std::max(0, int(wait.count()));
+        }
+        std::string line;
+        if (socket.receive(line, timeoutMs)) handle(line);
+
+        while (!retries.empty() && retries.begin()->first <= Clock::now()) {
+            sendGo(retries.begin()->second);
+            retries.erase(retries.begin());
+        }
+    }
+    for (const auto& game : games) {
+        socket.send("close " + std::to_string(game.first));
+    }
+    socket.send("quit");
+}
+
+void Client::nextTurn(uint64_t id) {
+    Game& game = games[id];
+    if (game.board.getCurrentPlayer() == BLACK) {
+        if (remaining.fetch_sub(1) > 0) sendGo(id);
+        return;
+    }
+    if (remaining.load() <= 0) return;
+    MoveList legal;
+    generateMoves(game.board, legal);
+    Move move = legal.moves[random() % legal.count].move;
+    socket.send("move " + std::to_string(id) + " " + moveToString(move));
+    pending++;
+}
+
+void Client::sendGo(uint64_t id) {
+    games[id].sent = Clock::now();
+    socket.send("go " + std::to_string(id) + " " + std::to_string(options.budgetMs));
+    pending++;
+}
+
+void Client::applyMove(uint64_t id, const std::string& text, const std::string& status) {
+    auto game = games.find(id);
+    if (game == games.end()) return;
+    Move move = parseMove(game->second.board, text);
+    if (move.isNull()) {
+        errors++;
+        restart(id);
+        return;
+    }
+    game->second.board.makeMove(move);
+    if (status.empty()) {
+        nextTurn(id);
+    } else {
+        restart(id);
+    }
+}
+
+void Client::restart(uint64_t id) {
+    games.erase(id);
+    socket.send("close " + std::to_string(id));
+    pending++;
+    if (remaining.load() > 0) {
+        socket.send("new");
+        pending++;
+    }
+}
+
+void Client::handle(const std::string& line) {
+    std::istringstream in(line);
+    std::string kind, text, status;
+    uint64_t id = 0;
+    in >> kind >> id;
+    pending--;
+
+    if (kind == "new") {
+        games[id].board.initializeBoard();
+        nextTurn(id);
+    } else if (kind == "moved") {
+        in >> text >> status;
+        applyMove(id, text, status);
+    } else if (kind == "bestmove") {
+        double milliseconds;
+        in >> text >> milliseconds >> status;
+        auto game = games.find(id);
+        if (game == games.end()) return;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - game->second.sent);
+        latency.record(uint64_t(elapsed.count()));
+        completed++;
+        game->second.retryMs = 0;
+        applyMove(id, text, status);
+    } else if (kind == "busy") {
+        busy++;
+        auto game = games.find(id);
+        if (game == games.end()) return;
+        int& retryMs = game->second.retryMs;
+        retryMs = retryMs ? std::min(2 * retryMs, MAX_RETRY_MS) : RETRY_MS;
+        retries.emplace(Clock::now() + std::chrono::milliseconds(retryMs), id);
+    } else if (kind == "error") {
+        std::fprintf(stderr, "loadgen: %s\n", line.c_str());
+        errors++;
+        if (games.count(id)) restart(id);
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return usage();
+
+    std::vector<std::unique_ptr<Client>> clients;
+    std::atomic<long> remaining(options.requests);
+    for (int i = 0; i < options.connections; i++) {
+        int fd = connectTo(options.port);
+        if (fd < 0) {
+            std::fprintf(stderr, "loadgen: cannot connect to 127.0.0.1:%d: %s\n", options.port,
+                         std::strerror(errno));
+            return 1;
+        }
+        clients.emplace_back(new Client(fd, options, remaining, unsigned(i + 1)));
+    }
+
+    int control = connectTo(options.port);
+    if (control >= 0) {
+        LineSocket socket(control);
+        std::string line;
+        socket.send("reset");
+        socket.receive(line, 5000);
+        socket.send("quit");
+    }
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<Client>& client : clients) {
+        Client* pointer = client.get();
+        threads.emplace_back([pointer]() { pointer->run(); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    LatencyHistogram latency;
+    uint64_t completed = 0, busy = 0, errors = 0;
+    for (const std::unique_ptr<Client>& client : clients) {
+        latency.add(client->latency);
+        completed += client->completed;
+        busy += client->busy;
+        errors += client->errors;
+    }
+    std::printf("%llu requests over %d connections x %d sessions in %.1f s\n", (unsigned long long)completed,
+                options.connections, options.sessions, seconds);
+    std::printf("%.1f req/s, p50 %.1f ms, p99 %.1f ms, max %.1f ms, %llu busy, %llu errors\n",
+                seconds > 0 ? completed / seconds : 0.0, latency.percentile(0.5) / 1000.0,
+                latency.percentile(0.99) / 1000.0, latency.getMax() / 1000.0, (unsigned long long)busy,
+                (unsigned long long)errors);
+
+    int fd = connectTo(options.port);
+    if (fd >= 0) {
+        LineSocket socket(fd);
+        std::string line;
+        if (socket.send("stats") && socket.receive(line, 5000)) std::printf("server: %s\n", line.c_str());
+        socket.send("quit");
+    }
+    return 0;
+}
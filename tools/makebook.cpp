@@ -0,0 +1,97 @@
+// Builds an opening book (engine/book.h) from a file of games, one game
+// per line as coordinate moves from the start position, e.g.
+//
+//   e2e4 e7e5 g1f3 b8c6 f1b5 a7a6
+//
+// Every position in the first `plies` moves of each game gets an entry for
+// the move played, weighted by how many games played it. Moves played in
+// fewer than `min-count` games are left out.
+//
+//   makebook <games.txt> <book.bin> [plies=14] [min-count=1]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "engine/board.h"
+#include "engine/book.h"
+#include "engine/movegen.h"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: makebook <games.txt> <book.bin> [plies=14] [min-count=1]\n");
+        return 1;
+    }
+    int plies = (argc > 3) ? std::max(1, std::atoi(argv[3])) : 14;
+    int minCount = (argc > 4) ? std::max(1, std::atoi(argv[4])) : 1;
+    
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::fprintf(stderr, "makebook: cannot open %s\n", argv[1]);
+        return 1;
+    }
+    
+    // (key, raw move) -> number of games that played it
+    std::map<std::pair<uint64_t, uint16_t>, int> counts;
+    std::string line;
+    int games = 0, lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') continue;
+        
+        Board board;
+        std::istringstream moves(line);
+        std::string text;
+        for (int ply = 0; ply < plies && moves >> text; ply++) {
+            MoveList list;
+            generateMoves(board, list);
+            Move played;
+            for (int i = 0; i < list.count; i++) {
+                if (moveToString(list.moves[i].move) == text) played = list.moves[i].move;
+            }
+            if (played.isNull()) {
+                std::fprintf(stderr, "makebook: line %d: cannot play %s\n", lineNumber, text.c_str());
+                break;
+            }
+            counts[std::make_pair(board.getKey(), played.raw())]++;
+            board.makeMove(played);
+        }
+        games++;
+    }
+    
+    // The map is already in key order, which is what the book's binary
+    // search needs; within a key the more popular moves go first.
+    std::vector<std::pair<std::pair<uint64_t, uint16_t>, int>> entries;
+    for (const auto& entry : counts) {
+        if (entry.second >= minCount) entries.push_back(entry);
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        if (a.first.first != b.first.first) return a.first.first < b.first.first;
+        return a.second > b.second;
+    });
+    
+    FILE* out = std::fopen(argv[2], "wb");
+    if (!out) {
+        std::fprintf(stderr, "makebook: cannot write %s\n", argv[2]);
+        return 1;
+    }
+    for (const auto& entry : entries) {
+        unsigned char bytes[OpeningBook::ENTRY_SIZE];
+        OpeningBook::writeEntry(bytes, entry.first.first, Move::fromRaw(entry.first.second),
+                                uint16_t(std::min(entry.second, 65535)));
+        std::fwrite(bytes, 1, sizeof(bytes), out);
+    }
+    if (std::fclose(out) != 0) {
+        std::fprintf(stderr, "makebook: error writing %s\n", argv[2]);
+        return 1;
+    }
+    
+    std::printf("%d games, %zu book entries\n", games, entries.size());
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Writes a network file (engine/nnue.h) whose weights are set by hand to
+// reproduce the material and piece-square part of the classical
+// evaluation, with each piece type's middlegame and endgame values
+// averaged. It is not a trained network: it lets the NNUE code be run,
+// timed and checked end to end, and a trained file in the same layout
+// replaces it.
+//
+//   nnuegen <out.nnue>
+//
+// Each side's piece-square sum is split over twelve first-layer units
+// (own and enemy pawns on files a-d and e-h, knights, bishops, rooks and
+// queens) in steps of UNIT centipawns, small enough per unit to stay
+// under the 127 activation limit in play. The hidden layers pass those
+// twelve through unchanged and the output takes own minus enemy.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "engine/nnue.h"
+#include "engine/psqt.h"
+
+namespace {
+
+const int UNIT = 10;
+const int GROUPS = 6;
+
+// First-layer unit a piece adds to, among its owner's six.
+int groupOf(PieceType type, int square) {
+    switch (type) {
+        case PAWN: return (square % 8 < 4) ? 0 : 1;
+        case KNIGHT: return 2;
+        case BISHOP: return 3;
+        case ROOK: return 4;
+        default: return 5;
+    }
+}
+
+template <typename T>
+T* part(std::vector<unsigned char>& bytes, size_t offset) {
+    return reinterpret_cast<T*>(bytes.data() + offset);
+}
+
+void writeLittleEndian(unsigned char* bytes, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: nnuegen <out.nnue>\n");
+        return 1;
+    }
+
+    const nnue::FileLayout layout = nnue::fileLayout();
+    std::vector<unsigned char> bytes(layout.size, 0);
+    std::memcpy(bytes.data(), nnue::MAGIC, sizeof(nnue::MAGIC));
+    writeLittleEndian(&bytes[8], nnue::FEATURES);
+    writeLittleEndian(&bytes[12], nnue::HALF_DIMENSIONS);
+    writeLittleEndian(&bytes[16], nnue::HIDDEN);
+
+    // Features are seen from White's side whatever the perspective, so an
+    // own piece scores like a White one on the same square and an enemy
+    // piece like a Black one.
+    int16_t* featureWeights = part<int16_t>(bytes, layout.featureWeights);
+    for (int king = 0; king < 64; king++) {
+        for (int type = PAWN; type < KING; type++) {
+            for (PieceColor color : {WHITE, BLACK}) {
+                Piece piece(PieceType(type), color);
+                for (int square = 0; square < 64; square++) {
+                    int sign = (color == WHITE) ? 1 : -1;
+                    double value = sign * (psqt::tables.middlegame[color][type][square] +
+                                           psqt::tables.endgame[color][type][square]) / 2.0;
+                    int unit = groupOf(piece.type, square) + (color == WHITE ? 0 : GROUPS);
+                    int feature = nnue::featureIndex(WHITE, king, piece, square);
+                    featureWeights[size_t(feature) * nnue::HALF_DIMENSIONS + unit] = int16_t(std::lround(value / UNIT));
+                }
+            }
+        }
+    }
+
+    // Weights of 1 << WEIGHT_SHIFT copy a unit to the next layer.
+    int8_t* hidden1Weights = part<int8_t>(bytes, layout.hidden1Weights);
+    int8_t* hidden2Weights = part<int8_t>(bytes, layout.hidden2Weights);
+    int8_t* outputWeights = part<int8_t>(bytes, layout.outputWeights);
+    for (int unit = 0; unit < 2 * GROUPS; unit++) {
+        hidden1Weights[nnue::denseIndex(unit, unit)] = 1 << nnue::WEIGHT_SHIFT;
+        hidden2Weights[nnue::denseIndex(unit, unit)] = 1 << nnue::WEIGHT_SHIFT;
+        int sign = (unit < GROUPS) ? 1 : -1;
+        outputWeights[unit] = int8_t(sign * UNIT * nnue::OUTPUT_SCALE);
+    }
+
+    std::FILE* out = std::fopen(argv[1], "wb");
+    if (!out) {
+        std::fprintf(stderr, "nnuegen: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    bool written = std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    if (std::fclose(out) != 0 || !written) {
+        std::fprintf(stderr, "nnuegen: cannot write %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
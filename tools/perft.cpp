@@ -0,0 +1,88 @@
+// Counts leaf nodes of the move generator over a fixed set of positions and
+// reports nodes per second. Suite results are checked against the published
+// counts, and any mismatch makes the exit status non-zero.
+//
+//   perft                 run the standard suite at its default depths
+//   perft <depth>         run the suite at a fixed depth
+//   perft <fen> <depth>   run a single position
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "engine/board.h"
+#include "engine/movegen.h"
+
+const int MAX_CHECKED_DEPTH = 5;
+
+struct PerftPosition {
+    const char* name;
+    const char* fen;
+    int depth;
+    uint64_t expected[MAX_CHECKED_DEPTH];  // depths 1-5
+};
+
+static const PerftPosition standardPositions[] = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5,
+     {20, 400, 8902, 197281, 4865609}},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4,
+     {48, 2039, 97862, 4085603, 193690690}},
+    {"position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5,
+     {14, 191, 2812, 43238, 674624}},
+    {"position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4,
+     {6, 264, 9467, 422333, 15833292}},
+    {"position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4,
+     {44, 1486, 62379, 2103487, 89941194}},
+    {"position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4,
+     {46, 2079, 89890, 3894594, 164075551}},
+};
+
+// `expected` is 0 when there is no count to check against.
+static bool runPosition(const char* name, const std::string& fen, int depth, uint64_t expected,
+                        uint64_t& totalNodes, double& totalSeconds) {
+    Board board;
+    if (!board.loadFEN(fen)) {
+        std::fprintf(stderr, "perft: invalid FEN for %s: %s\n", name, fen.c_str());
+        return false;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = perft(board, depth);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::printf("%-10s depth %d  nodes %12llu  time %8.3f s  nps %12.0f\n", name, depth,
+                (unsigned long long)nodes, seconds, seconds > 0 ? nodes / seconds : 0.0);
+    totalNodes += nodes;
+    totalSeconds += seconds;
+    if (expected != 0 && nodes != expected) {
+        std::fprintf(stderr, "perft: %s depth %d: expected %llu nodes\n", name, depth,
+                     (unsigned long long)expected);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0;
+    
+    if (argc == 3) {
+        return runPosition("custom", argv[1], std::atoi(argv[2]), 0, totalNodes, totalSeconds) ? 0 : 1;
+    }
+    
+    int fixedDepth = (argc == 2) ? std::atoi(argv[1]) : 0;
+    bool allMatched = true;
+    for (const PerftPosition& position : standardPositions) {
+        int depth = fixedDepth > 0 ? fixedDepth : position.depth;
+        uint64_t expected = (depth >= 1 && depth <= MAX_CHECKED_DEPTH) ? position.expected[depth - 1] : 0;
+        if (!runPosition(position.name, position.fen, depth, expected, totalNodes, totalSeconds)) {
+            allMatched = false;
+        }
+    }
+    
+    std::printf("total      nodes %12llu  time %8.3f s  nps %12.0f\n", (unsigned long long)totalNodes,
+                totalSeconds, totalSeconds > 0 ? totalNodes / totalSeconds : 0.0);
+    return allMatched ? 0 : 1;
+}
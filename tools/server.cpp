@@ -0,0 +1,366 @@
+// Headless game server: keeps many games in memory and searches the AI's
+// moves on one bounded pool of worker threads. The line protocol is
+// described in engine/game_server.h; tools/loadgen drives it.
+//
+//   server [options]
+//     --port N            listen on 127.0.0.1:N; without it, serve one
+//                         client on stdin/stdout
+//     --workers N         search threads (default: hardware threads)
+//     --hash MB           hash table shared by the workers (default 64)
+//     --sessions N        most games kept at once (default 100000)
+//     --queue N           most AI requests waiting in all (default 4096)
+//     --client-queue N    most AI requests waiting per client (default 256)
+//     --budget MS         budget of a `go` that names none (default 100)
+//     --max-budget MS     largest budget a `go` may ask for (default 10000)
+//     --report S          print the stats line to stderr every S seconds
+//
+// Besides the protocol, `quit` closes the connection that sends it. On
+// stdin, end of input waits for the answers still due and then exits; a
+// listening server runs until interrupted. Either way the final stats go
+// to stderr. A client that stops reading has no more input read once 1 MB
+// of answers waits for it, so it cannot make the server buffer without
+// limit.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "engine/game_server.h"
+
+namespace {
+
+const size_t OUTPUT_LIMIT = 1 << 20;
+const int STDIN_CLIENT = 0;
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void onSignal(int) {
+    interrupted = 1;
+}
+
+struct Options {
+    ServerConfig config;
+    int port = 0;
+    int reportSeconds = 0;
+};
+
+int usage() {
+    std::fprintf(stderr, "usage: server [--port N] [--workers N] [--hash MB] [--sessions N] [--queue N]\n"
+                         "              [--client-queue N] [--budget MS] [--max-budget MS] [--report S]\n");
+    return 1;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    options.config.workers = std::max(1, int(std::thread::hardware_concurrency()));
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        long value = std::atol(argv[++i]);
+        if (value <= 0) return false;
+
+        if (arg == "--port") options.port = int(value);
+        else if (arg == "--workers") options.config.workers = int(value);
+        else if (arg == "--hash") options.config.hashMegabytes = size_t(value);
+        else if (arg == "--sessions") options.config.maxSessions = size_t(value);
+        else if (arg == "--queue") options.config.maxQueued = size_t(value);
+        else if (arg == "--client-queue") options.config.maxQueuedPerClient = size_t(value);
+        else if (arg == "--budget") options.config.defaultBudgetMs = int(value);
+        else if (arg == "--max-budget") options.config.maxBudgetMs = int(value);
+        else if (arg == "--report") options.reportSeconds = int(value);
+        else return false;
+    }
+    return true;
+}
+
+std::string formatStats(const ServerStats& stats) {
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer),
+                  "%llu requests in %.1f s: %.1f req/s, p50 %.1f ms, p99 %.1f ms, max %.1f ms, %llu busy, %llu late",
+                  (unsigned long long)stats.completed, stats.seconds, stats.requestsPerSecond(),
+                  stats.latency.percentile(0.5) / 1000.0, stats.latency.percentile(0.99) / 1000.0,
+                  stats.latency.getMax() / 1000.0, (unsigned long long)stats.rejected,
+                  (unsigned long long)stats.late);
+    return buffer;
+}
+
+int listenOn(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 128) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// One client: a socket, or stdin and stdout.
+struct Connection {
+    int inFd;
+    int outFd;
+    std::string input;
+    std::string output;
+    bool reading;   // false after end of input or `quit`
+    bool quitting;  // close once the output is written
+};
+
+// Answers come from the I/O thread and from the workers; they wait here
+// until the I/O thread moves them to their connection, woken through a
+// pipe.
+class Outbox {
+public:
+    Outbox() : signalled(false) {
+        if (pipe(wakeFds) != 0) wakeFds[0] = wakeFds[1] = -1;
+        fcntl(wakeFds[0], F_SETFL, fcntl(wakeFds[0], F_GETFL) | O_NONBLOCK);
+    }
+
+    int getWakeFd() const { return wakeFds[0]; }
+
+    void post(int client, const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        lines.push_back(std::make_pair(client, line));
+        if (!signalled) {
+            signalled = true;
+            char byte = 1;
+            ssize_t written = write(wakeFds[1], &byte, 1);
+            (void)written;  // only fails on a full pipe, which wakes the I/O thread too
+        }
+    }
+
+    std::vector<std::pair<int, std::string>> take() {
+        char bytes[64];
+        while (read(wakeFds[0], bytes, sizeof(bytes)) > 0) {
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        signalled = false;
+        std::vector<std::pair<int, std::string>> taken;
+        taken.swap(lines);
+        return taken;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::pair<int, std::string>> lines;
+    bool signalled;
+    int wakeFds[2];
+};
+
+class ServerLoop {
+public:
+    ServerLoop(const Options& loopOptions, int listenFd)
+        : options(loopOptions), listener(listenFd), nextClient(STDIN_CLIENT + 1),
+          server(options.config, [this](int client, const std::string& line) { outbox.post(client, line); }) {
+        if (listener < 0) {
+            connections[STDIN_CLIENT] = Connection{STDIN_FILENO, STDOUT_FILENO, "", "", true, false};
+        }
+    }
+
+    void run();
+
+    ServerStats getStats() const { return server.getStats(); }
+
+private:
+    void acceptClients();
+    void readFrom(int client, Connection& connection);
+    void writeTo(int client, Connection& connection);
+    void deliver();
+    void closeConnection(int client);
+    // Stdin has ended and every answer due has been written.
+    bool stdinFinished() const;
+
+    Options options;
+    int listener;
+    int nextClient;
+    std::map<int, Connection> connections;
+    Outbox outbox;
+    GameServer server;  // last, so its workers stop before the outbox goes
+};
+
+void ServerLoop::run() {
+    auto lastReport = std::chrono::steady_clock::now();
+    while (!interrupted && !stdinFinished()) {
+        std::vector<pollfd> fds;
+        std::vector<int> owners;  // client of each entry; -1 for the others
+        fds.push_back(pollfd{outbox.getWakeFd(), POLLIN, 0});
+        owners.push_back(-1);
+        if (listener >= 0) {
+            fds.push_back(pollfd{listener, POLLIN, 0});
+            owners.push_back(-1);
+        }
+        for (const auto& entry : connections) {
+            const Connection& connection = entry.second;
+            short inEvents = (connection.reading && connection.output.size() < OUTPUT_LIMIT) ? POLLIN : 0;
+            short outEvents = connection.output.empty() ? 0 : POLLOUT;
+            // A negative descriptor is skipped, so a closed stdin does not
+            // keep reporting its hangup.
+            if (connection.inFd == connection.outFd) {
+                short events = short(inEvents | outEvents);
+                fds.push_back(pollfd{events ? connection.inFd : -1, events, 0});
+                owners.push_back(entry.first);
+            } else {
+                fds.push_back(pollfd{inEvents ? connection.inFd : -1, inEvents, 0});
+                fds.push_back(pollfd{outEvents ? connection.outFd : -1, outEvents, 0});
+                owners.push_back(entry.first);
+                owners.push_back(entry.first);
+            }
+        }
+
+        int timeoutMs = options.reportSeconds > 0 ? 100 : 1000;
+        if (poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents) deliver();
+        if (listener >= 0 && fds[1].revents) acceptClients();
+        for (size_t i = 0; i < fds.size(); i++) {
+            auto connection = connections.find(owners[i]);
+            if (!fds[i].revents || connection == connections.end()) continue;
+            if (fds[i].revents & POLLOUT) writeTo(owners[i], connection->second);
+            connection = connections.find(owners[i]);
+            if (connection != connections.end() && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                readFrom(owners[i], connection->second);
+            }
+        }
+        deliver();
+
+        auto now = std::chrono::steady_clock::now();
+        if (options.reportSeconds > 0 && now - lastReport >= std::chrono::seconds(options.reportSeconds)) {
+            std::fprintf(stderr, "%s\n", formatStats(server.getStats()).c_str());
+            lastReport = now;
+        }
+    }
+}
+
+void ServerLoop::acceptClients() {
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        connections[nextClient++] = Connection{fd, fd, "", "", true, false};
+    }
+}
+
+void ServerLoop::readFrom(int client, Connection& connection) {
+    if (!connection.reading) return;
+    char buffer[65536];
+    ssize_t count = read(connection.inFd, buffer, sizeof(buffer));
+    if (count < 0 && (errno == EAGAIN || errno == EINTR)) return;
+    if (count <= 0) {
+        // Stdin stays open until its answers are written; a socket goes now.
+        connection.reading = false;
+        if (client != STDIN_CLIENT) closeConnection(client);
+        return;
+    }
+
+    connection.input.append(buffer, size_t(count));
+    size_t start = 0, end;
+    while (connection.reading && (end = connection.input.find('\n', start)) != std::string::npos) {
+        std::string line = connection.input.substr(start, end - start);
+        start = end + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line == "quit") {
+            server.dropClient(client);
+            connection.reading = false;
+            connection.quitting = true;
+        } else {
+            server.handle(client, line);
+        }
+    }
+    connection.input.erase(0, start);
+    if (connection.quitting && connection.output.empty()) closeConnection(client);
+}
+
+void ServerLoop::writeTo(int client, Connection& connection) {
+    while (!connection.output.empty()) {
+        ssize_t count = write(connection.outFd, connection.output.data(), connection.output.size());
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0 && errno == EAGAIN) return;
+        if (count <= 0) {
+            closeConnection(client);
+            return;
+        }
+        connection.output.erase(0, size_t(count));
+    }
+    if (connection.quitting) closeConnection(client);
+}
+
+void ServerLoop::deliver() {
+    for (const auto& line : outbox.take()) {
+        auto connection = connections.find(line.first);
+        if (connection == connections.end()) continue;
+        connection->second.output += line.second;
+        connection->second.output += '\n';
+    }
+    // Try straight away; poll only waits for the sockets that are full.
+    for (auto it = connections.begin(); it != connections.end();) {
+        auto current = it++;
+        if (!current->second.output.empty()) writeTo(current->first, current->second);
+    }
+}
+
+void ServerLoop::closeConnection(int client) {
+    auto connection = connections.find(client);
+    if (connection == connections.end()) return;
+    server.dropClient(client);
+    if (client != STDIN_CLIENT) close(connection->second.inFd);
+    connections.erase(connection);
+}
+
+bool ServerLoop::stdinFinished() const {
+    if (listener >= 0) return false;
+    auto connection = connections.find(STDIN_CLIENT);
+    if (connection == connections.end()) return true;
+    return !connection->second.reading && connection->second.output.empty() && server.isIdle();
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) return usage();
+
+    int listener = -1;
+    if (options.port > 0) {
+        listener = listenOn(options.port);
+        if (listener < 0) {
+            std::fprintf(stderr, "server: cannot listen on port %d: %s\n", options.port, std::strerror(errno));
+            return 1;
+        }
+        std::fprintf(stderr, "server: listening on 127.0.0.1:%d with %d workers\n", options.port,
+                     options.config.workers);
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    ServerLoop loop(options, listener);
+    loop.run();
+    std::fprintf(stderr, "%s\n", formatStats(loop.getStats()).c_str());
+    if (listener >= 0) close(listener);
+    return 0;
+}
@@ -0,0 +1,451 @@
+// Self-play tournament runner for measuring the difficulty levels against
+// each other. Games run concurrently, one per worker thread, and each
+// opening is played twice with colors reversed.
+//
+//   tournament [options]
+//     --pair A:B          players A and B (repeatable, default 3:1 3:2 2:1)
+//     --games N           games per pairing (default 100, rounded up to even)
+//     --concurrency N     worker threads (default: hardware threads)
+//     --openings FILE     one FEN or EPD per line; '#' starts a comment
+//     --max-plies N       adjudicate longer games as draws (default 300)
+//     --hash MB           hash per player (default 8)
+//     --book FILE         opening book shared by all players (tools/makebook)
+//     --csv FILE          per-pairing summary as CSV
+//     --json FILE         per-pairing summary and totals as JSON
+//     --archive FILE      append every game to a game archive (tools/games)
+//
+// A player is a difficulty level (1-3, the window's Easy/Medium/Hard, with
+// its random noise) optionally followed by "@ms" to set its time per move,
+// e.g. "3@100". Elo differences are from A's point of view with a 95%
+// confidence interval.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/archive.h"
+#include "engine/board.h"
+#include "engine/movegen.h"
+#include "engine/search.h"
+
+namespace {
+
+const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Short, balanced lines from the start position, used without --openings.
+const char* const defaultOpenings[] = {
+    "e2e4 e7e5 g1f3 b8c6", "e2e4 c7c5 g1f3 d7d6", "e2e4 e7e6 d2d4 d7d5", "e2e4 c7c6 d2d4 d7d5",
+    "d2d4 d7d5 c2c4 e7e6", "d2d4 g8f6 c2c4 g7g6", "c2c4 e7e5 b1c3 g8f6", "g1f3 d7d5 g2g3 g8f6",
+};
+
+struct PlayerSpec {
+    int level;
+    int timeMs;  // 0 keeps the level's own budget
+    std::string name;
+};
+
+struct Pairing {
+    PlayerSpec a, b;
+};
+
+struct Config {
+    std::vector<Pairing> pairings;
+    int gamesPerPairing = 100;
+    int concurrency = 0;
+    int maxPlies = 300;
+    int hashMegabytes = 8;
+    std::string openingsFile, bookFile, csvFile, jsonFile, archiveFile;
+};
+
+struct GameJob {
+    int pairing;
+    int opening;
+    bool aIsWhite;
+};
+
+// Per-player totals accumulate the moves that player made.
+struct PlayerStats {
+    int moves = 0;
+    double seconds = 0;
+    uint64_t nodes = 0;
+};
+
+// Scores and totals by color; the caller maps them to players A and B.
+struct GameResult {
+    double whiteScore;  // 1, 0.5 or 0
+    int plies;
+    PlayerStats stats[3];
+};
+
+bool parsePlayer(const std::string& text, PlayerSpec& player) {
+    player.level = std::atoi(text.c_str());
+    player.timeMs = 0;
+    size_t at = text.find('@');
+    if (at != std::string::npos) player.timeMs = std::atoi(text.c_str() + at + 1);
+    player.name = text;
+    return player.level >= 1 && player.level <= 3 && player.timeMs >= 0;
+}
+
+bool parsePairing(const std::string& text, Pairing& pairing) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) return false;
+    return parsePlayer(text.substr(0, colon), pairing.a) && parsePlayer(text.substr(colon + 1), pairing.b);
+}
+
+SearchLimits limitsFor(const PlayerSpec& player) {
+    SearchLimits limits = SearchLimits::forDifficulty(player.level);
+    if (player.timeMs > 0) limits.timeMs = player.timeMs;
+    return limits;
+}
+
+// Plays coordinate-notation moves; false if one is not possible.
+bool applyMoves(Board& board, const std::string& moves) {
+    size_t start = 0;
+    while (start < moves.size()) {
+        size_t end = moves.find(' ', start);
+        if (end == std::string::npos) end = moves.size();
+        std::string text = moves.substr(start, end - start);
+        start = end + 1;
+        if (text.empty()) continue;
+
+        MoveList list;
+        generateMoves(board, list);
+        bool found = false;
+        for (int i = 0; i < list.count && !found; i++) {
+            if (moveToString(list.moves[i].move) == text) {
+                board.makeMove(list.moves[i].move);
+                found = true;
+            }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+bool loadOpenings(const Config& config, std::vector<Board>& openings) {
+    if (config.openingsFile.empty()) {
+        for (const char* line : defaultOpenings) {
+            Board board;
+            board.loadFEN(START_FEN);
+            if (!applyMoves(board, line)) return false;
+            openings.push_back(board);
+        }
+        return true;
+    }
+
+    std::ifstream in(config.openingsFile);
+    if (!in) {
+        std::fprintf(stderr, "tournament: cannot open %s\n", config.openingsFile.c_str());
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        Board board;
+        if (!board.loadFEN(line)) {
+            std::fprintf(stderr, "tournament: skipping invalid FEN: %s\n", line.c_str());
+            continue;
+        }
+        openings.push_back(board);
+    }
+    return !openings.empty();
+}
+
+class Worker {
+public:
+    Worker(int hashMegabytes, const std::shared_ptr<const OpeningBook>& book)
+        : white(hashMegabytes), black(hashMegabytes) {
+        white.setBook(book);
+        black.setBook(book);
+    }
+
+    GameResult play(const Board& opening, const PlayerSpec& whitePlayer, const PlayerSpec& blackPlayer,
+                    int maxPlies, Board& board);
+
+private:
+    Search white, black;
+};
+
+// The game ends when the side to move has no moves (mate if in check,
+// otherwise stalemate), and is drawn by threefold repetition, the
+// fifty-move rule or the ply limit. `board` is left at the final position.
+GameResult Worker::play(const Board& opening, const PlayerSpec& whitePlayer, const PlayerSpec& blackPlayer,
+                        int maxPlies, Board& board) {
+    GameResult result = GameResult();
+    result.whiteScore = 0.5;
+    board = opening;
+    white.clearHash();
+    black.clearHash();
+
+    std::vector<uint64_t> keys{board.getKey()};
+
+    for (int ply = 0; ply < maxPlies; ply++) {
+        PieceColor side = board.getCurrentPlayer();
+        MoveList legal;
+        generateMoves(board, legal);
+        if (legal.empty()) {
+            if (isInCheck(board)) result.whiteScore = (side == WHITE) ? 0.0 : 1.0;
+            break;
+        }
+
+        Search& search = (side == WHITE) ? white : black;
+        PlayerStats& stats = result.stats[side];
+        search.setPosition(board);
+        auto start = std::chrono::steady_clock::now();
+        Move move = search.getBestMove(limitsFor(side == WHITE ? whitePlayer : blackPlayer));
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.nodes += search.getNodes();
+        stats.moves++;
+
+        if (move.isNull()) break;
+
+        board.makeMove(move);
+        result.plies = ply + 1;
+        if (board.getHalfmoveClock() >= 100) break;
+
+        if (std::count(keys.begin(), keys.end(), board.getKey()) >= 2) break;
+        keys.push_back(board.getKey());
+    }
+    return result;
+}
+
+// Results of one pairing from player A's point of view.
+struct PairingSummary {
+    int games = 0, wins = 0, draws = 0, losses = 0;
+    int plies = 0;
+    PlayerStats a, b;
+
+    double score() const { return games > 0 ? (wins + 0.5 * draws) / games : 0.5; }
+};
+
+double eloFromScore(double score) {
+    score = std::min(std::max(score, 0.001), 0.999);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+// Half-width of the 95% interval, from the spread of the per-game scores.
+double eloError(const PairingSummary& summary) {
+    if (summary.games < 2) return 0;
+    double mean = summary.score();
+    double variance = (summary.wins * (1 - mean) * (1 - mean) + summary.draws * (0.5 - mean) * (0.5 - mean) +
+                       summary.losses * mean * mean) / summary.games;
+    double margin = 1.96 * std::sqrt(variance / summary.games);
+    return (eloFromScore(mean + margin) - eloFromScore(mean - margin)) / 2;
+}
+
+double msPerMove(const PlayerStats& stats) {
+    return stats.moves > 0 ? stats.seconds * 1000 / stats.moves : 0;
+}
+
+double nodesPerSecond(const PlayerStats& stats) {
+    return stats.seconds > 0 ? stats.nodes / stats.seconds : 0;
+}
+
+void addStats(PlayerStats& total, const PlayerStats& stats) {
+    total.moves += stats.moves;
+    total.seconds += stats.seconds;
+    total.nodes += stats.nodes;
+}
+
+bool writeCsv(const std::string& path, const Config& config, const std::vector<PairingSummary>& summaries) {
+    FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) return false;
+    std::fprintf(out, "player_a,player_b,games,wins,draws,losses,score,elo,elo_error,"
+                      "ms_per_move_a,ms_per_move_b,nps_a,nps_b,avg_plies\n");
+    for (size_t i = 0; i < summaries.size(); i++) {
+        const PairingSummary& s = summaries[i];
+        std::fprintf(out, "%s,%s,%d,%d,%d,%d,%.4f,%.1f,%.1f,%.2f,%.2f,%.0f,%.0f,%.1f\n",
+                     config.pairings[i].a.name.c_str(), config.pairings[i].b.name.c_str(), s.games, s.wins,
+                     s.draws, s.losses, s.score(), eloFromScore(s.score()), eloError(s), msPerMove(s.a),
+                     msPerMove(s.b), nodesPerSecond(s.a), nodesPerSecond(s.b),
+                     s.games > 0 ? double(s.plies) / s.games : 0.0);
+    }
+    return std::fclose(out) == 0;
+}
+
+bool writeJson(const std::string& path, const Config& config, const std::vector<PairingSummary>& summaries,
+               int games, double seconds) {
+    FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) return false;
+    std::fprintf(out, "{\n  \"games\": %d,\n  \"seconds\": %.3f,\n  \"games_per_second\": %.3f,\n"
+                      "  \"concurrency\": %d,\n  \"pairings\": [\n",
+                 games, seconds, seconds > 0 ? games / seconds : 0.0, config.concurrency);
+    for (size_t i = 0; i < summaries.size(); i++) {
+        const PairingSummary& s = summaries[i];
+        std::fprintf(out, "    {\"a\": \"%s\", \"b\": \"%s\", \"games\": %d, \"wins\": %d, \"draws\": %d, "
+                          "\"losses\": %d, \"score\": %.4f, \"elo\": %.1f, \"elo_error\": %.1f, "
+                          "\"ms_per_move_a\": %.2f, \"ms_per_move_b\": %.2f, \"nps_a\": %.0f, \"nps_b\": %.0f}%s\n",
+                     config.pairings[i].a.name.c_str(), config.pairings[i].b.name.c_str(), s.games, s.wins,
+                     s.draws, s.losses, s.score(), eloFromScore(s.score()), eloError(s), msPerMove(s.a),
+                     msPerMove(s.b), nodesPerSecond(s.a), nodesPerSecond(s.b),
+                     i + 1 < summaries.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+    return std::fclose(out) == 0;
+}
+
+bool parseArguments(int argc, char** argv, Config& config) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+
+        if (option == "--pair") {
+            Pairing pairing;
+            if (!parsePairing(value, pairing)) return false;
+            config.pairings.push_back(pairing);
+        } else if (option == "--games") {
+            config.gamesPerPairing = std::max(2, std::atoi(value.c_str()));
+        } else if (option == "--concurrency") {
+            config.concurrency = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--openings") {
+            config.openingsFile = value;
+        } else if (option == "--max-plies") {
+            config.maxPlies = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--hash") {
+            config.hashMegabytes = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--book") {
+            config.bookFile = value;
+        } else if (option == "--csv") {
+            config.csvFile = value;
+        } else if (option == "--json") {
+            config.jsonFile = value;
+        } else if (option == "--archive") {
+            config.archiveFile = value;
+        } else {
+            return false;
+        }
+    }
+
+    if (config.pairings.empty()) {
+        for (const char* text : {"3:1", "3:2", "2:1"}) {
+            Pairing pairing;
+            parsePairing(text, pairing);
+            config.pairings.push_back(pairing);
+        }
+    }
+    config.gamesPerPairing += config.gamesPerPairing % 2;
+    if (config.concurrency == 0) {
+        config.concurrency = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parseArguments(argc, argv, config)) {
+        std::fprintf(stderr, "usage: tournament [--pair A:B]... [--games N] [--concurrency N] [--openings FILE]\n"
+                             "                  [--max-plies N] [--hash MB] [--book FILE]\n"
+                             "                  [--csv FILE] [--json FILE] [--archive FILE]\n");
+        return 1;
+    }
+
+    std::vector<Board> openings;
+    if (!loadOpenings(config, openings)) return 1;
+    
+    std::shared_ptr<OpeningBook> book;
+    if (!config.bookFile.empty()) {
+        book = std::make_shared<OpeningBook>();
+        if (!book->open(config.bookFile)) {
+            std::fprintf(stderr, "tournament: cannot open book %s\n", config.bookFile.c_str());
+            return 1;
+        }
+    }
+
+    // Consecutive games share an opening with colors swapped, so each
+    // opening's bias cancels out within a pairing.
+    std::vector<GameJob> jobs;
+    for (int p = 0; p < int(config.pairings.size()); p++) {
+        for (int g = 0; g < config.gamesPerPairing; g++) {
+            jobs.push_back(GameJob{p, (g / 2) % int(openings.size()), g % 2 == 0});
+        }
+    }
+    std::vector<GameResult> results(jobs.size());
+    std::atomic<size_t> nextJob(0);
+    std::atomic<size_t> finished(0);
+    std::mutex archiveMutex;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < config.concurrency; t++) {
+        threads.emplace_back([&]() {
+            Worker worker(config.hashMegabytes, book);
+            Board board;
+            for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+                const GameJob& job = jobs[i];
+                const Pairing& pairing = config.pairings[job.pairing];
+                results[i] = job.aIsWhite
+                                 ? worker.play(openings[job.opening], pairing.a, pairing.b, config.maxPlies, board)
+                                 : worker.play(openings[job.opening], pairing.b, pairing.a, config.maxPlies, board);
+                if (!config.archiveFile.empty()) {
+                    GameOutcome outcome = DRAWN;
+                    if (results[i].whiteScore == 1.0) outcome = WHITE_WINS;
+                    else if (results[i].whiteScore == 0.0) outcome = BLACK_WINS;
+                    std::lock_guard<std::mutex> lock(archiveMutex);
+                    if (!GameArchive::append(config.archiveFile, board, outcome)) {
+                        std::fprintf(stderr, "tournament: cannot write %s\n", config.archiveFile.c_str());
+                    }
+                }
+                size_t done = ++finished;
+                if (done % 10 == 0 || done == jobs.size()) {
+                    std::fprintf(stderr, "\r%zu/%zu games", done, jobs.size());
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "\n");
+
+    std::vector<PairingSummary> summaries(config.pairings.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        PairingSummary& summary = summaries[jobs[i].pairing];
+        const GameResult& result = results[i];
+        PieceColor colorA = jobs[i].aIsWhite ? WHITE : BLACK;
+        double scoreA = jobs[i].aIsWhite ? result.whiteScore : 1.0 - result.whiteScore;
+
+        summary.games++;
+        if (scoreA == 1.0) summary.wins++;
+        else if (scoreA == 0.0) summary.losses++;
+        else summary.draws++;
+        summary.plies += result.plies;
+        addStats(summary.a, result.stats[colorA]);
+        addStats(summary.b, result.stats[opponent(colorA)]);
+    }
+
+    std::printf("%-8s %-8s %6s %5s %5s %5s %7s %16s %9s %9s %10s %10s\n", "A", "B", "games", "win", "draw",
+                "loss", "score", "elo", "ms/mv A", "ms/mv B", "nps A", "nps B");
+    for (size_t i = 0; i < summaries.size(); i++) {
+        const PairingSummary& s = summaries[i];
+        std::printf("%-8s %-8s %6d %5d %5d %5d %7.3f %+7.1f +/- %5.1f %9.2f %9.2f %10.0f %10.0f\n",
+                    config.pairings[i].a.name.c_str(), config.pairings[i].b.name.c_str(), s.games, s.wins,
+                    s.draws, s.losses, s.score(), eloFromScore(s.score()), eloError(s), msPerMove(s.a),
+                    msPerMove(s.b), nodesPerSecond(s.a), nodesPerSecond(s.b));
+    }
+    std::printf("%zu games in %.1f s (%.2f games/s) on %d threads\n", jobs.size(), seconds,
+                seconds > 0 ? jobs.size() / seconds : 0.0, config.concurrency);
+
+    if (!config.csvFile.empty() && !writeCsv(config.csvFile, config, summaries)) {
+        std::fprintf(stderr, "tournament: cannot write %s\n", config.csvFile.c_str());
+        return 1;
+    }
+    if (!config.jsonFile.empty() &&
+        !writeJson(config.jsonFile, config, summaries, int(jobs.size()), seconds)) {
+        std::fprintf(stderr, "tournament: cannot write %s\n", config.jsonFile.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,318 @@
+// Headless engine speaking the UCI protocol on stdin/stdout, for GUIs and
+// match runners such as cutechess-cli.
+//
+// Supported commands: uci, isready, ucinewgame, setoption (Hash, Threads,
+// BookFile, EvalFile, BitbaseFile, StatsFile, Ponder), position [startpos | fen <fen>] [moves ...], go
+// [ponder] [depth | movetime | wtime/btime/winc/binc/movestogo | nodes |
+// infinite], ponderhit, stop, quit.
+//
+// The search runs on its own thread so `stop` and `isready` are answered
+// while it thinks; it prints `info` after every completed iteration and
+// `bestmove` when it finishes, with the reply it expects as the move to
+// ponder on. After `go infinite` the bestmove waits for `stop` even if the
+// search ends sooner. With StatsFile set, each search also appends one
+// line of JSON to that file: the move and the search's counters. With EvalFile set to
+// an NNUE network the search evaluates with it instead of the classical
+// evaluation; with BitbaseFile set to tables from bitbasegen it plays
+// endings of up to four pieces without mistakes.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "engine/board.h"
+#include "engine/movegen.h"
+#include "engine/nnue.h"
+#include "engine/search.h"
+
+static const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static const int DEFAULT_HASH_MB = 16;
+static const int MAX_HASH_MB = 4096;
+static const int MAX_THREADS = 64;
+
+// Both the input loop and the search thread write to stdout.
+static std::mutex outputMutex;
+
+static void send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::fputs(line.c_str(), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
+
+class UciEngine {
+public:
+    UciEngine() : search(DEFAULT_HASH_MB), stopFlag(false), ponderFlag(false) {
+        search.setStopFlag(&stopFlag);
+        search.setPonderFlag(&ponderFlag);
+        board.loadFEN(START_FEN);
+    }
+
+    ~UciEngine() { stop(); }
+
+    // Returns false on `quit`.
+    bool handle(const std::string& line);
+
+private:
+    void setOption(std::istringstream& in);
+    void setPosition(std::istringstream& in);
+    void go(std::istringstream& in);
+    void stop();
+    void appendStats(Move best);
+
+    static void printInfo(const SearchInfo& info, PieceColor side);
+
+    Board board;
+    Search search;
+    std::thread worker;
+    std::atomic<bool> stopFlag;
+    std::atomic<bool> ponderFlag;
+    Move expectedReply;  // written by the search thread only
+    std::string statsFile;
+};
+
+bool UciEngine::handle(const std::string& line) {
+    std::istringstream in(line);
+    std::string command;
+    if (!(in >> command)) return true;
+
+    if (command == "uci") {
+        send("id name EnhancedChess");
+        send("id author EnhancedChess developers");
+        send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max " +
+             std::to_string(MAX_HASH_MB));
+        send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+        send("option name BookFile type string default <empty>");
+        send("option name EvalFile type string default <empty>");
+        send("option name BitbaseFile type string default <empty>");
+        send("option name StatsFile type string default <empty>");
+        send("option name Ponder type check default false");
+        send("uciok");
+    } else if (command == "isready") {
+        send("readyok");
+    } else if (command == "ucinewgame") {
+        stop();
+        search.clearHash();
+    } else if (command == "setoption") {
+        setOption(in);
+    } else if (command == "position") {
+        setPosition(in);
+    } else if (command == "go") {
+        go(in);
+    } else if (command == "ponderhit") {
+        ponderFlag.store(false);
+    } else if (command == "stop") {
+        stop();
+    } else if (command == "quit") {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void UciEngine::setOption(std::istringstream& in) {
+    std::string token, name, value;
+    in >> token;  // "name"
+    while (in >> token && token != "value") {
+        name += (name.empty() ? "" : " ") + token;
+    }
+    std::getline(in >> std::ws, value);
+
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    int number = std::atoi(value.c_str());
+
+    stop();
+    if (name == "hash") {
+        search.setHashSize(std::min(std::max(number, 1), MAX_HASH_MB));
+    } else if (name == "threads") {
+        search.setThreads(std::min(std::max(number, 1), MAX_THREADS));
+    } else if (name == "bookfile") {
+        std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>();
+        if (value.empty() || value == "<empty>") {
+            search.setBook(nullptr);
+        } else if (book->open(value)) {
+            search.setBook(book);
+            send("info string book " + value + " with " + std::to_string(book->getEntryCount()) + " entries");
+        } else {
+            search.setBook(nullptr);
+            send("info string cannot open book " + value);
+        }
+    } else if (name == "evalfile") {
+        std::shared_ptr<nnue::Network> network = std::make_shared<nnue::Network>();
+        if (value.empty() || value == "<empty>") {
+            search.setNetwork(nullptr);
+        } else if (network->open(value)) {
+            search.setNetwork(network);
+            send("info string network " + value + " with " + nnue::simdName() + " kernels");
+        } else {
+            search.setNetwork(nullptr);
+            send("info string cannot open network " + value);
+        }
+    } else if (name == "bitbasefile") {
+        std::shared_ptr<bitbase::Bitbases> bitbases = std::make_shared<bitbase::Bitbases>();
+        if (value.empty() || value == "<empty>") {
+            search.setBitbases(nullptr);
+        } else if (bitbases->open(value)) {
+            search.setBitbases(bitbases);
+            send("info string bitbases " + value + " with " + std::to_string(bitbases->getTableCount()) + " tables");
+        } else {
+            search.setBitbases(nullptr);
+            send("info string cannot open bitbases " + value);
+        }
+    } else if (name == "statsfile") {
+        statsFile = (value == "<empty>") ? "" : value;
+    }
+}
+
+void UciEngine::setPosition(std::istringstream& in) {
+    stop();
+
+    std::string token, fen;
+    in >> token;
+    if (token == "startpos") {
+        fen = START_FEN;
+        in >> token;  // "moves", if any
+    } else if (token == "fen") {
+        while (in >> token && token != "moves") {
+            fen += token + " ";
+        }
+    } else {
+        return;
+    }
+    if (!board.loadFEN(fen)) {
+        send("info string invalid fen " + fen);
+        return;
+    }
+
+    // Moves are matched against the generated ones, so a move this engine
+    // cannot make ends the list instead of corrupting the board.
+    while (in >> token) {
+        MoveList moves;
+        generateMoves(board, moves);
+        bool found = false;
+        for (int i = 0; i < moves.count; i++) {
+            if (moveToString(moves.moves[i].move) == token) {
+                board.makeMove(moves.moves[i].move);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            send("info string illegal move " + token);
+            return;
+        }
+    }
+}
+
+void UciEngine::go(std::istringstream& in) {
+    stop();
+
+    SearchLimits limits;
+    int time[3] = {0, 0, 0};
+    int increment[3] = {0, 0, 0};
+    int movesToGo = 0;
+    bool ponder = false;
+    bool infinite = false;
+    std::string token;
+    while (in >> token) {
+        if (token == "depth") in >> limits.depth;
+        else if (token == "movetime") in >> limits.timeMs;
+        else if (token == "nodes") in >> limits.nodes;
+        else if (token == "wtime") in >> time[WHITE];
+        else if (token == "btime") in >> time[BLACK];
+        else if (token == "winc") in >> increment[WHITE];
+        else if (token == "binc") in >> increment[BLACK];
+        else if (token == "movestogo") in >> movesToGo;
+        else if (token == "ponder") ponder = true;
+        else if (token == "infinite") infinite = true;
+    }
+
+    // With a clock, spend an even share of the remaining time plus most of
+    // the increment, and always keep a margin for communication lag.
+    PieceColor side = board.getCurrentPlayer();
+    if (limits.timeMs == 0 && time[side] > 0) {
+        int share = time[side] / (movesToGo > 0 ? movesToGo + 1 : 30) + increment[side] * 3 / 4;
+        limits.timeMs = std::max(1, std::min(share, time[side] - 50));
+    }
+
+    search.setPosition(board);
+    expectedReply = Move();
+    search.setInfoCallback([this, side](const SearchInfo& info) {
+        expectedReply = (info.pvLength >= 2) ? info.pv[1] : Move();
+        printInfo(info, side);
+    });
+    stopFlag.store(false);
+    // A ponder search ignores its time and node limits until `ponderhit`,
+    // or runs until `stop` if the guess was wrong.
+    ponderFlag.store(ponder);
+    worker = std::thread([this, limits, infinite]() {
+        Move best = search.getBestMove(limits);
+        // `go infinite` is answered only after `stop`, however soon the
+        // search itself ends: at its depth limit, on a forced mate or with
+        // a book move.
+        while (infinite && !stopFlag.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::string line = "bestmove " + moveToString(best);
+        if (!expectedReply.isNull()) line += " ponder " + moveToString(expectedReply);
+        send(line);
+        if (!statsFile.empty()) appendStats(best);
+    });
+}
+
+void UciEngine::appendStats(Move best) {
+    std::FILE* file = std::fopen(statsFile.c_str(), "a");
+    if (!file) {
+        send("info string cannot write " + statsFile);
+        return;
+    }
+    std::string line = "{\"bestmove\":\"" + moveToString(best) + "\",\"search\":" + search.getStats().toJson() + "}\n";
+    std::fputs(line.c_str(), file);
+    std::fclose(file);
+}
+
+void UciEngine::stop() {
+    if (worker.joinable()) {
+        stopFlag.store(true);
+        worker.join();
+    }
+    ponderFlag.store(false);
+}
+
+void UciEngine::printInfo(const SearchInfo& info, PieceColor side) {
+    // UCI scores are from the side to move's point of view.
+    int score = (side == WHITE) ? info.score : -info.score;
+    uint64_t nps = info.timeMs > 0 ? info.nodes * 1000 / info.timeMs : 0;
+
+    // Mates are reported in moves, negative when the engine is being mated.
+    std::string scoreText = "cp " + std::to_string(score);
+    if (isMateScore(score)) {
+        scoreText = "mate " + std::to_string(mateInMoves(score));
+    }
+
+    std::string line = "info depth " + std::to_string(info.depth) + " score " + scoreText +
+                       " nodes " + std::to_string(info.nodes) + " nps " + std::to_string(nps) + " time " +
+                       std::to_string(info.timeMs) + " pv";
+    for (int i = 0; i < info.pvLength; i++) {
+        line += " " + moveToString(info.pv[i]);
+    }
+    send(line);
+}
+
+int main() {
+    UciEngine engine;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!engine.handle(line)) break;
+    }
+    return 0;
+}